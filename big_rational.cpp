@@ -0,0 +1,998 @@
+/*****************************************************************************
+ * This model program demonstrates exact rational numbers that never overflow.
+ * While the numerator and the denominator fit into 64 bits they are stored
+ * inline, and operations cost about as much as with the int class of
+ * operator_overload.cpp; a result that does not fit moves to heap-allocated
+ * big integers, which are multiplied with Karatsuba's algorithm and reduced
+ * with Lehmer's gcd.
+ * g++ big_rational.cpp -std=c++20 -O2 -o big_rational
+ *****************************************************************************/
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+
+
+// The class of operator_overload.cpp (only what the benchmarks need), kept
+// as the baseline. Products of int overflow silently.
+
+int Euclid(int a, int b)
+{
+	while ( a % b )
+	{
+		int temp = a;
+		a = b;
+		b = temp % b;
+	}
+	return abs(b);
+}
+
+
+
+class IntRational
+{
+public:
+	IntRational(int p, int q) : p_ {p}, q_ {q}
+	{
+		if ( q_ < 0 ) { p_ = -p_; q_ = -q_; }
+		Reduce();
+	}
+	const IntRational& operator +=(const IntRational& other)
+	{
+		p_ = p_ * other.q_ + other.p_ * q_;
+		q_ *= other.q_;
+		Reduce();
+		return *this;
+	}
+
+private:
+	int p_;
+	int q_;
+	void Reduce()
+	{
+		const int k = Euclid(p_, q_);
+		p_ /= k;
+		q_ /= k;
+	}
+
+	friend ostream& operator <<(ostream& os, const IntRational& r)
+	{
+		return os << r.p_ << '/' << r.q_;
+	}
+};
+
+
+
+//-----------------------------------------------------------------------------
+
+
+using int128 = __int128;  // GCC and Clang extension
+using uint128 = unsigned __int128;
+
+inline uint64_t Magnitude(int64_t x)  // |x| without overflow for INT64_MIN, no branch
+{
+	const uint64_t sign = x >> 63;
+	return (static_cast<uint64_t>(x) ^ sign) - sign;
+}
+
+inline uint128 Magnitude(int128 x) { return x < 0 ? -static_cast<uint128>(x) : x; }
+
+
+
+// Stein's binary gcd, as in rational_arithmetic.cpp
+uint64_t BinaryGcd(uint64_t a, uint64_t b)
+{
+	while ( (a | b) >> 63 )  // Euclid steps until the signed difference works
+	{
+		if ( b == 0 )  return a;
+		a %= b;
+		swap(a, b);
+	}
+	if ( a == 0 )  return b;
+	if ( b == 0 )  return a;
+	int az = countr_zero(a);
+	const int shift = min(az, countr_zero(b));
+	b >>= countr_zero(b);
+	while ( a )
+	{
+		a >>= az;
+		const int64_t diff = static_cast<int64_t>(b - a);
+		az = countr_zero(static_cast<uint64_t>(diff));
+		b = min(a, b);
+		a = Magnitude(diff);
+	}
+	return b << shift;
+}
+
+
+
+uint128 Gcd(uint128 a, uint128 b)
+{
+	while ( (a | b) >> 64 )
+	{
+		if ( b == 0 )  return a;
+		a %= b;
+		swap(a, b);
+	}
+	return BinaryGcd(static_cast<uint64_t>(a), static_cast<uint64_t>(b));
+}
+
+
+
+//-----------------------------------------------------------------------------
+
+
+// Unsigned integer of any size: little-endian 64-bit limbs without leading
+// zero limbs, so that 0 has none.
+class Natural
+{
+public:
+	Natural() = default;
+	Natural(uint64_t x) { if ( x )  limbs_.push_back(x); }
+	explicit Natural(uint128 x);
+
+	bool IsZero() const { return limbs_.empty(); }
+	size_t size() const { return limbs_.size(); }
+	uint64_t operator [](size_t i) const { return limbs_[i]; }
+	size_t BitWidth() const;
+	uint64_t Bits(size_t shift) const;  // The low 64 bits of *this >> shift
+	bool Fits(uint64_t max) const { return IsZero() || (size() == 1 && limbs_[0] <= max); }
+
+private:
+	vector<uint64_t> limbs_;
+	void Trim() { while ( !limbs_.empty() && limbs_.back() == 0 )  limbs_.pop_back(); }
+
+	friend int Compare(const Natural& a, const Natural& b);
+	friend Natural operator +(const Natural& a, const Natural& b);
+	friend Natural operator -(const Natural& a, const Natural& b);
+	friend Natural Schoolbook(const Natural& a, const Natural& b);
+	friend Natural operator *(const Natural& a, const Natural& b);
+	friend void DivMod(const Natural& a, const Natural& b, Natural& quotient, Natural& remainder);
+};
+
+
+
+Natural::Natural(uint128 x)
+{
+	for ( ; x; x >>= 64 )  limbs_.push_back(static_cast<uint64_t>(x));
+}
+
+
+
+size_t Natural::BitWidth() const
+{
+	return IsZero() ? 0 : 64 * (size() - 1) + bit_width(limbs_.back());
+}
+
+
+
+uint64_t Natural::Bits(size_t shift) const
+{
+	const size_t i = shift / 64, s = shift % 64;
+	const uint64_t lo = i < size() ? limbs_[i] : 0;
+	const uint64_t hi = i + 1 < size() ? limbs_[i + 1] : 0;
+	return s ? (lo >> s) | (hi << (64 - s)) : lo;
+}
+
+
+
+int Compare(const Natural& a, const Natural& b)
+{
+	if ( a.size() != b.size() )  return a.size() < b.size() ? -1 : 1;
+	for ( size_t i = a.size(); i-- > 0; )
+		if ( a.limbs_[i] != b.limbs_[i] )  return a.limbs_[i] < b.limbs_[i] ? -1 : 1;
+	return 0;
+}
+
+inline bool operator ==(const Natural& a, const Natural& b) { return Compare(a, b) == 0; }
+inline bool operator <(const Natural& a, const Natural& b) { return Compare(a, b) < 0; }
+
+
+
+Natural operator +(const Natural& a, const Natural& b)
+{
+	const Natural& x = a.size() < b.size() ? b : a;
+	const Natural& y = a.size() < b.size() ? a : b;
+	Natural r;
+	r.limbs_.resize(x.size() + 1);
+	uint64_t carry = 0;
+	for ( size_t i = 0; i < x.size(); ++i )
+	{
+		const uint128 s = static_cast<uint128>(x.limbs_[i]) + (i < y.size() ? y.limbs_[i] : 0) + carry;
+		r.limbs_[i] = static_cast<uint64_t>(s);
+		carry = static_cast<uint64_t>(s >> 64);
+	}
+	r.limbs_.back() = carry;
+	r.Trim();
+	return r;
+}
+
+
+
+Natural operator -(const Natural& a, const Natural& b)  // a >= b
+{
+	if ( a < b )  throw domain_error("Natural: negative difference");
+	Natural r = a;
+	uint64_t borrow = 0;
+	for ( size_t i = 0; i < a.size() && (borrow || i < b.size()); ++i )
+	{
+		const uint128 d = static_cast<uint128>(a.limbs_[i]) - (i < b.size() ? b.limbs_[i] : 0) - borrow;
+		r.limbs_[i] = static_cast<uint64_t>(d);
+		borrow = static_cast<uint64_t>(d >> 64) & 1;
+	}
+	r.Trim();
+	return r;
+}
+
+
+
+// Kernels on raw limb arrays, so that Karatsuba's recursion does not
+// allocate
+
+void MulSchoolbook(const uint64_t* a, size_t na, const uint64_t* b, size_t nb, uint64_t* r)
+{
+	fill(r, r + na + nb, 0);
+	for ( size_t i = 0; i < na; ++i )
+	{
+		uint64_t carry = 0;
+		for ( size_t j = 0; j < nb; ++j )
+		{
+			const uint128 t = static_cast<uint128>(a[i]) * b[j] + r[i + j] + carry;
+			r[i + j] = static_cast<uint64_t>(t);
+			carry = static_cast<uint64_t>(t >> 64);
+		}
+		r[i + nb] = carry;
+	}
+}
+
+
+
+uint64_t AddLimbs(uint64_t* r, size_t n, const uint64_t* x, size_t nx)  // r += x, nx <= n
+{
+	uint64_t carry = 0;
+	size_t i = 0;
+	for ( ; i < nx; ++i )
+	{
+		const uint128 s = static_cast<uint128>(r[i]) + x[i] + carry;
+		r[i] = static_cast<uint64_t>(s);
+		carry = static_cast<uint64_t>(s >> 64);
+	}
+	for ( ; carry && i < n; ++i )  carry = ++r[i] == 0;
+	return carry;
+}
+
+
+
+uint64_t SubLimbs(uint64_t* r, size_t n, const uint64_t* x, size_t nx)  // r -= x, nx <= n
+{
+	uint64_t borrow = 0;
+	size_t i = 0;
+	for ( ; i < nx; ++i )
+	{
+		const uint128 d = static_cast<uint128>(r[i]) - x[i] - borrow;
+		r[i] = static_cast<uint64_t>(d);
+		borrow = static_cast<uint64_t>(d >> 64) & 1;
+	}
+	for ( ; borrow && i < n; ++i )  borrow = r[i]-- == 0;
+	return borrow;
+}
+
+
+
+// r[0, 2n) = a b for n-limb a and b: with a = a1 2^(64 m) + a0 and the same
+// for b, a b = z2 2^(128 m) + z1 2^(64 m) + z0 with three half-size products
+// z0 = a0 b0, z2 = a1 b1 and z1 = (a0 + a1)(b0 + b1) - z0 - z2.
+// 'scratch' holds 4n + 256 limbs. Below the threshold schoolbook
+// multiplication is faster: with g++ -O2 on x86-64, one level of the
+// recursion over schoolbook halves first wins between 48 and 56 limbs.
+constexpr size_t karatsuba_threshold = 48;  // Limbs
+
+void MulKaratsuba(const uint64_t* a, const uint64_t* b, size_t n, uint64_t* r, uint64_t* scratch)
+{
+	if ( n < karatsuba_threshold )
+	{
+		MulSchoolbook(a, n, b, n, r);
+		return;
+	}
+	const size_t m = n / 2, h = n - m;
+	uint64_t* sa = scratch;  // a0 + a1 and b0 + b1, h + 1 limbs each
+	uint64_t* sb = sa + h + 1;
+	uint64_t* z1 = sb + h + 1;  // 2h + 2 limbs
+	uint64_t* next = z1 + 2 * h + 2;
+	copy(a + m, a + n, sa);
+	sa[h] = AddLimbs(sa, h, a, m);
+	copy(b + m, b + n, sb);
+	sb[h] = AddLimbs(sb, h, b, m);
+	MulKaratsuba(a, b, m, r, next);
+	MulKaratsuba(a + m, b + m, h, r + 2 * m, next);
+	MulKaratsuba(sa, sb, h + 1, z1, next);
+	SubLimbs(z1, 2 * h + 2, r, 2 * m);
+	SubLimbs(z1, 2 * h + 2, r + 2 * m, 2 * h);
+	AddLimbs(r + m, 2 * n - m, z1, 2 * h + 2);
+}
+
+
+
+Natural Schoolbook(const Natural& a, const Natural& b)
+{
+	Natural r;
+	if ( a.IsZero() || b.IsZero() )  return r;
+	r.limbs_.resize(a.size() + b.size());
+	MulSchoolbook(a.limbs_.data(), a.size(), b.limbs_.data(), b.size(), r.limbs_.data());
+	r.Trim();
+	return r;
+}
+
+
+
+// The longer factor is cut into pieces of the length of the shorter one,
+// and every piece is multiplied with Karatsuba's algorithm.
+Natural operator *(const Natural& a, const Natural& b)
+{
+	const Natural& x = a.size() < b.size() ? b : a;
+	const Natural& y = a.size() < b.size() ? a : b;
+	if ( y.size() < karatsuba_threshold )  return Schoolbook(x, y);
+	const size_t n = y.size();
+	Natural r;
+	r.limbs_.assign(x.size() + n, 0);
+	vector<uint64_t> piece(n), product(2 * n), scratch(4 * n + 256);
+	for ( size_t i = 0; i < x.size(); i += n )
+	{
+		const size_t k = min(n, x.size() - i);
+		fill(copy(x.limbs_.begin() + i, x.limbs_.begin() + i + k, piece.begin()), piece.end(), 0);
+		MulKaratsuba(piece.data(), y.limbs_.data(), n, product.data(), scratch.data());
+		AddLimbs(&r.limbs_[i], r.size() - i, product.data(), min(2 * n, r.size() - i));
+	}
+	r.Trim();
+	return r;
+}
+
+
+
+// Knuth's algorithm D (TAOCP 4.3.1): after shifting both values so that the
+// top bit of the divisor is set, a quotient limb estimated from the top two
+// limbs of the remainder is at most 2 too large.
+void DivMod(const Natural& a, const Natural& b, Natural& quotient, Natural& remainder)
+{
+	if ( b.IsZero() )  throw domain_error("Natural: division by zero");
+	if ( a < b )
+	{
+		quotient = Natural();
+		remainder = a;
+		return;
+	}
+	const size_t n = b.size(), m = a.size() - n;
+	Natural q;
+	q.limbs_.assign(m + 1, 0);
+	if ( n == 1 )
+	{
+		uint128 r = 0;
+		for ( size_t j = a.size(); j-- > 0; )
+		{
+			const uint128 num = (r << 64) | a.limbs_[j];
+			q.limbs_[j] = static_cast<uint64_t>(num / b.limbs_[0]);
+			r = num % b.limbs_[0];
+		}
+		q.Trim();
+		quotient = move(q);
+		remainder = Natural(static_cast<uint64_t>(r));
+		return;
+	}
+	const int s = countl_zero(b.limbs_.back());
+	vector<uint64_t> v(n), u(a.size() + 1);
+	for ( size_t i = n; i-- > 0; )
+		v[i] = (b.limbs_[i] << s) | (s && i ? b.limbs_[i - 1] >> (64 - s) : 0);
+	u[a.size()] = s ? a.limbs_.back() >> (64 - s) : 0;
+	for ( size_t i = a.size(); i-- > 0; )
+		u[i] = (a.limbs_[i] << s) | (s && i ? a.limbs_[i - 1] >> (64 - s) : 0);
+
+	for ( size_t j = m + 1; j-- > 0; )
+	{
+		const uint128 num = (static_cast<uint128>(u[j + n]) << 64) | u[j + n - 1];
+		uint128 qhat = num / v[n - 1];
+		uint128 rhat = num - qhat * v[n - 1];
+		while ( qhat >> 64 || qhat * v[n - 2] > ((rhat << 64) | u[j + n - 2]) )
+		{
+			--qhat;
+			rhat += v[n - 1];
+			if ( rhat >> 64 )  break;
+		}
+		uint64_t carry = 0, borrow = 0;  // u[j, j + n] -= qhat * v
+		for ( size_t i = 0; i < n; ++i )
+		{
+			const uint128 p = qhat * v[i] + carry;
+			carry = static_cast<uint64_t>(p >> 64);
+			const uint128 d = static_cast<uint128>(u[i + j]) - static_cast<uint64_t>(p) - borrow;
+			u[i + j] = static_cast<uint64_t>(d);
+			borrow = static_cast<uint64_t>(d >> 64) & 1;
+		}
+		const uint128 d = static_cast<uint128>(u[j + n]) - carry - borrow;
+		u[j + n] = static_cast<uint64_t>(d);
+		if ( d >> 64 )  // Negative: qhat was one too large, add v back
+		{
+			--qhat;
+			uint64_t c = 0;
+			for ( size_t i = 0; i < n; ++i )
+			{
+				const uint128 t = static_cast<uint128>(u[i + j]) + v[i] + c;
+				u[i + j] = static_cast<uint64_t>(t);
+				c = static_cast<uint64_t>(t >> 64);
+			}
+			u[j + n] += c;
+		}
+		q.limbs_[j] = static_cast<uint64_t>(qhat);
+	}
+	q.Trim();
+	quotient = move(q);
+	remainder.limbs_.resize(n);
+	for ( size_t i = 0; i < n; ++i )
+		remainder.limbs_[i] = (u[i] >> s) | (s ? u[i + 1] << (64 - s) : 0);
+	remainder.Trim();
+}
+
+Natural operator /(const Natural& a, const Natural& b)
+{
+	Natural q, r;
+	DivMod(a, b, q, r);
+	return q;
+}
+
+Natural operator %(const Natural& a, const Natural& b)
+{
+	Natural q, r;
+	DivMod(a, b, q, r);
+	return r;
+}
+
+
+
+string ToString(Natural x)
+{
+	if ( x.IsZero() )  return "0";
+	const Natural base = uint64_t {10'000'000'000'000'000'000u};  // 10^19
+	vector<uint64_t> chunks;
+	Natural q, r;
+	while ( !x.IsZero() )
+	{
+		DivMod(x, base, q, r);
+		chunks.push_back(r.IsZero() ? 0 : r[0]);
+		x = move(q);
+	}
+	ostringstream os;
+	os << chunks.back();
+	for ( size_t i = chunks.size() - 1; i-- > 0; )  os << setw(19) << setfill('0') << chunks[i];
+	return os.str();
+}
+
+
+
+// Euclid's algorithm with a full division per step, for comparison
+Natural EuclidGcd(Natural a, Natural b)
+{
+	while ( !b.IsZero() )
+	{
+		a = a % b;
+		swap(a, b);
+	}
+	return a;
+}
+
+
+
+// x a + y b for cofactors of opposite signs (or one of them 0) with a
+// nonnegative result
+Natural Combine(const Natural& a, int64_t x, const Natural& b, int64_t y)
+{
+	if ( y <= 0 )  return a * Natural(static_cast<uint64_t>(x)) - b * Natural(Magnitude(y));
+	return b * Natural(static_cast<uint64_t>(y)) - a * Natural(Magnitude(x));
+}
+
+
+
+// Lehmer's algorithm (Knuth's algorithm L): the Euclid steps that the top 62
+// bits of a and b determine are done on single words, accumulating cofactors
+// A, B, C, D, and then applied to the big values at once, instead of a
+// division of big values per step. When the top bits do not determine even
+// one quotient, a full division step is done.
+Natural Gcd(Natural a, Natural b)
+{
+	if ( a < b )  swap(a, b);
+	while ( b.size() > 1 )
+	{
+		const size_t shift = a.BitWidth() - 62;
+		int64_t x = a.Bits(shift), y = b.Bits(shift);
+		int64_t A = 1, B = 0, C = 0, D = 1;
+		while ( y + C != 0 && y + D != 0 )
+		{
+			const int64_t q = (x + A) / (y + C);
+			if ( q != (x + B) / (y + D) )  break;
+			int64_t t = A - q * C;
+			A = C;
+			C = t;
+			t = B - q * D;
+			B = D;
+			D = t;
+			t = x - q * y;
+			x = y;
+			y = t;
+		}
+		if ( B == 0 )
+		{
+			a = a % b;
+			swap(a, b);
+		}
+		else
+		{
+			Natural c = Combine(a, A, b, B);
+			b = Combine(a, C, b, D);
+			a = move(c);
+		}
+	}
+	if ( b.IsZero() )  return a;
+	const Natural r = a % b;
+	return BinaryGcd(b[0], r.IsZero() ? 0 : r[0]);
+}
+
+
+
+//-----------------------------------------------------------------------------
+
+
+// Exact rational number, always reduced with q > 0. While p and q fit into
+// 64 bits (|p|, q <= INT64_MAX, as in rational_arithmetic.cpp) they are
+// stored inline and operations use 128-bit intermediates; a result that does
+// not fit moves to a heap-allocated Big, and a big result that fits into 64
+// bits again moves back.
+class BigRational
+{
+public:
+	BigRational(int64_t p = 0, int64_t q = 1);
+	BigRational(bool negative, Natural p, Natural q);
+	BigRational(const BigRational& other) : p_ {other.p_}, q_ {other.q_},
+		big_ {other.big_ ? make_unique<Big>(*other.big_) : nullptr} {}
+	BigRational(BigRational&& other) noexcept = default;
+	BigRational& operator =(const BigRational& other);
+	BigRational& operator =(BigRational&& other) noexcept = default;
+
+	bool IsSmall() const { return !big_; }
+	size_t Limbs() const { return big_ ? max(big_->p.size(), big_->q.size()) : 1; }
+	const BigRational& operator +=(const BigRational& other);
+	const BigRational& operator -=(const BigRational& other);
+	const BigRational& operator *=(const BigRational& other);
+	const BigRational& operator /=(const BigRational& other);
+
+private:
+	struct Big
+	{
+		bool negative;
+		Natural p;
+		Natural q;
+	};
+	int64_t p_;
+	int64_t q_;
+	unique_ptr<Big> big_;
+
+	void Assign(int128 p, int128 q);
+	void Assign(bool negative, Natural p, Natural q);
+	void Store(bool negative, Natural p, Natural q);
+	const Big& View(Big& scratch) const;
+	void AddBig(const BigRational& other, bool subtract);
+
+	friend bool operator ==(const BigRational& lhs, const BigRational& rhs);
+	friend bool operator <(const BigRational& lhs, const BigRational& rhs);
+	friend ostream& operator <<(ostream& os, const BigRational& r);
+};
+
+
+
+constexpr uint64_t small_max = numeric_limits<int64_t>::max();
+
+inline bool FitsSmall(int128 x) { return Magnitude(x) <= small_max; }
+
+
+
+BigRational::BigRational(int64_t p, int64_t q)
+{
+	if ( q == 0 )  throw invalid_argument("BigRational: zero denominator");
+	if ( q < 0 )  Assign(-static_cast<int128>(p), -static_cast<int128>(q));
+	else  Assign(p, q);
+}
+
+
+
+BigRational::BigRational(bool negative, Natural p, Natural q)
+{
+	if ( q.IsZero() )  throw invalid_argument("BigRational: zero denominator");
+	Assign(negative, move(p), move(q));
+}
+
+
+
+BigRational& BigRational::operator =(const BigRational& other)
+{
+	if ( this == &other )  return *this;
+	p_ = other.p_;
+	q_ = other.q_;
+	if ( !other.big_ )  big_.reset();
+	else if ( big_ )  *big_ = *other.big_;
+	else  big_ = make_unique<Big>(*other.big_);
+	return *this;
+}
+
+
+
+// The small path: as Rational<Reduction::eager>, but a result that does not
+// fit is promoted instead of throwing.
+void BigRational::Assign(int128 p, int128 q)
+{
+	if ( FitsSmall(p) && FitsSmall(q) )
+	{
+		const int64_t g = BinaryGcd(Magnitude(static_cast<int64_t>(p)), static_cast<uint64_t>(q));
+		p_ = static_cast<int64_t>(p);
+		q_ = static_cast<int64_t>(q);
+		if ( g != 1 ) { p_ /= g; q_ /= g; }  // Divisions cost more than the gcd
+		big_.reset();
+		return;
+	}
+	const int128 g = Gcd(Magnitude(p), q);
+	p /= g;
+	q /= g;
+	if ( FitsSmall(p) && FitsSmall(q) )
+	{
+		p_ = static_cast<int64_t>(p);
+		q_ = static_cast<int64_t>(q);
+		big_.reset();
+		return;
+	}
+	big_ = make_unique<Big>(Big {p < 0, Natural(Magnitude(p)), Natural(static_cast<uint128>(q))});
+}
+
+
+
+inline bool IsOne(const Natural& x) { return x.size() == 1 && x[0] == 1; }
+
+inline Natural Quotient(const Natural& x, const Natural& g) { return IsOne(g) ? x : x / g; }
+
+
+
+void BigRational::Assign(bool negative, Natural p, Natural q)
+{
+	const Natural g = Gcd(p, q);
+	Store(negative, Quotient(p, g), Quotient(q, g));
+}
+
+
+
+void BigRational::Store(bool negative, Natural p, Natural q)  // Reduced p/q
+{
+	if ( p.IsZero() )  q = uint64_t {1};
+	if ( p.Fits(small_max) && q.Fits(small_max) )
+	{
+		const int64_t m = p.IsZero() ? 0 : static_cast<int64_t>(p[0]);
+		p_ = negative ? -m : m;
+		q_ = static_cast<int64_t>(q[0]);
+		big_.reset();
+		return;
+	}
+	if ( !big_ )  big_ = make_unique<Big>();
+	*big_ = Big {negative, move(p), move(q)};
+}
+
+
+
+// A small value as a Big in 'scratch', a big one as it is
+const BigRational::Big& BigRational::View(Big& scratch) const
+{
+	if ( big_ )  return *big_;
+	scratch = Big {p_ < 0, Natural(Magnitude(p_)), Natural(static_cast<uint64_t>(q_))};
+	return scratch;
+}
+
+
+
+// Henrici's method, as in mpq_add of GMP: with g = gcd(q1, q2) and
+// t = p1 (q2 / g) + p2 (q1 / g), the sum is t / g2 over (q1 / g)(q2 / g2)
+// with g2 = gcd(t, g), already reduced. The gcds are of values half as long
+// as the unreduced numerator and denominator, and g is often 1.
+void BigRational::AddBig(const BigRational& other, bool subtract)
+{
+	Big s1, s2;
+	const Big& x = View(s1);
+	const Big& y = other.View(s2);
+	const Natural g = Gcd(x.q, y.q);
+	const Natural xq = Quotient(x.q, g), yq = Quotient(y.q, g);
+	Natural t = x.p * yq, b = y.p * xq;
+	const bool nt = x.negative, nb = y.negative != subtract;
+	bool negative = nt;
+	if ( nt == nb )  t = t + b;
+	else if ( t < b ) { t = b - t; negative = nb; }
+	else  t = t - b;
+	if ( IsOne(g) )  return Store(negative, move(t), x.q * y.q);
+	const Natural g2 = Gcd(t, g);
+	Store(negative, Quotient(t, g2), xq * Quotient(y.q, g2));
+}
+
+
+
+const BigRational& BigRational::operator +=(const BigRational& other)
+{
+	if ( big_ || other.big_ )  AddBig(other, false);
+	else if ( q_ == other.q_ )  Assign(static_cast<int128>(p_) + other.p_, q_);
+	else  Assign(static_cast<int128>(p_) * other.q_ + static_cast<int128>(other.p_) * q_,
+	             static_cast<int128>(q_) * other.q_);
+	return *this;
+}
+
+
+
+const BigRational& BigRational::operator -=(const BigRational& other)
+{
+	if ( big_ || other.big_ )  AddBig(other, true);
+	else if ( q_ == other.q_ )  Assign(static_cast<int128>(p_) - other.p_, q_);
+	else  Assign(static_cast<int128>(p_) * other.q_ - static_cast<int128>(other.p_) * q_,
+	             static_cast<int128>(q_) * other.q_);
+	return *this;
+}
+
+
+
+const BigRational& BigRational::operator *=(const BigRational& other)
+{
+	if ( !big_ && !other.big_ )
+	{
+		Assign(static_cast<int128>(p_) * other.p_, static_cast<int128>(q_) * other.q_);
+		return *this;
+	}
+	Big s1, s2;  // Cross gcds, as in mpq_mul of GMP
+	const Big& x = View(s1);
+	const Big& y = other.View(s2);
+	const Natural g1 = Gcd(x.p, y.q), g2 = Gcd(y.p, x.q);
+	Store(x.negative != y.negative, Quotient(x.p, g1) * Quotient(y.p, g2),
+	      Quotient(x.q, g2) * Quotient(y.q, g1));
+	return *this;
+}
+
+
+
+const BigRational& BigRational::operator /=(const BigRational& other)
+{
+	if ( !other.big_ && other.p_ == 0 )  throw domain_error("BigRational: division by zero");
+	if ( !big_ && !other.big_ )
+	{
+		const int128 p = static_cast<int128>(p_) * other.q_;
+		const int128 q = static_cast<int128>(q_) * other.p_;
+		if ( q < 0 )  Assign(-p, -q);
+		else  Assign(p, q);
+		return *this;
+	}
+	Big s1, s2;
+	const Big& x = View(s1);
+	const Big& y = other.View(s2);
+	const Natural g1 = Gcd(x.p, y.p), g2 = Gcd(x.q, y.q);
+	Store(x.negative != y.negative, Quotient(x.p, g1) * Quotient(y.q, g2),
+	      Quotient(x.q, g2) * Quotient(y.p, g1));
+	return *this;
+}
+
+
+
+const BigRational operator +(BigRational lhs, const BigRational& rhs) { return lhs += rhs; }
+const BigRational operator -(BigRational lhs, const BigRational& rhs) { return lhs -= rhs; }
+const BigRational operator *(BigRational lhs, const BigRational& rhs) { return lhs *= rhs; }
+const BigRational operator /(BigRational lhs, const BigRational& rhs) { return lhs /= rhs; }
+
+
+
+// Reduced forms are unique, and a big value never equals a small one
+bool operator ==(const BigRational& lhs, const BigRational& rhs)
+{
+	if ( !lhs.big_ && !rhs.big_ )  return lhs.p_ == rhs.p_ && lhs.q_ == rhs.q_;
+	if ( !lhs.big_ || !rhs.big_ )  return false;
+	return lhs.big_->negative == rhs.big_->negative && lhs.big_->p == rhs.big_->p
+	       && lhs.big_->q == rhs.big_->q;
+}
+
+
+
+bool operator <(const BigRational& lhs, const BigRational& rhs)  // For sets and maps
+{
+	if ( !lhs.big_ && !rhs.big_ )
+		return static_cast<int128>(lhs.p_) * rhs.q_ < static_cast<int128>(rhs.p_) * lhs.q_;
+	BigRational::Big s1, s2;
+	const BigRational::Big& x = lhs.View(s1);
+	const BigRational::Big& y = rhs.View(s2);
+	const int sx = x.p.IsZero() ? 0 : x.negative ? -1 : 1;
+	const int sy = y.p.IsZero() ? 0 : y.negative ? -1 : 1;
+	if ( sx != sy )  return sx < sy;
+	const int c = Compare(x.p * y.q, y.p * x.q);
+	return sx < 0 ? c > 0 : c < 0;
+}
+
+
+
+ostream& operator <<(ostream& os, const BigRational& r)
+{
+	if ( !r.big_ )  return os << r.p_ << '/' << r.q_;
+	return os << (r.big_->negative ? "-" : "") << ToString(r.big_->p) << '/' << ToString(r.big_->q);
+}
+
+
+
+//-----------------------------------------------------------------------------
+
+
+template <typename F>
+double TimeSec(F f)
+{
+	const auto t = chrono::steady_clock::now();
+	f();
+	return chrono::duration<double>(chrono::steady_clock::now() - t).count();
+}
+
+
+
+template <typename R>
+string ToString(const R& r)
+{
+	ostringstream os;
+	os << r;
+	return os.str();
+}
+
+
+
+void Demo()
+{
+	BigRational r1(3, 10), r2(1, 10);
+	cout << r1 + r2 << ' ' << r1 - r2 << ' ' << r1 * r2 << ' ' << r1 / r2 << '\n';
+	assert( r1 + r2 == BigRational(2, 5) );
+	assert( r1 - r2 == BigRational(1, 5) );
+	assert( r1 * r2 == BigRational(3, 100) );
+	assert( r1 / r2 == BigRational(3, 1) );
+
+	// Harmonic numbers: IntRational goes wrong at H(20), 64 bits end at H(47)
+	BigRational h;
+	for ( int n = 1; n <= 100; ++n )
+	{
+		h += BigRational(1, n);
+		if ( n == 46 || n == 47 || n == 100 )
+			cout << "H(" << n << ") = " << h << (h.IsSmall() ? " (inline)\n" : " (heap)\n");
+	}
+
+	// (1 + 1/n)^n with n = 2^10 by squaring, and back to a small value
+	BigRational e(1025, 1024);
+	for ( int i = 0; i < 10; ++i )  e *= e;
+	cout << "(1 + 1/1024)^1024 has " << e.Limbs() << "-limb numerator and denominator, ";
+	BigRational x = e;
+	x /= e;
+	x -= BigRational(1, 3);
+	cout << "x / x - 1/3 = " << x << (x.IsSmall() ? " (inline)\n" : " (heap)\n");
+	assert( x == BigRational(2, 3) && x.IsSmall() );
+}
+
+
+
+// Sums of 'chain' consecutive terms, as in rational_arithmetic.cpp
+template <typename R>
+vector<R> ChainSums(const vector<R>& terms, size_t chain)
+{
+	vector<R> sums;
+	for ( size_t i = 0; i + chain <= terms.size(); i += chain )
+	{
+		R sum(0, 1);
+		for ( size_t k = i; k < i + chain; ++k )  sum += terms[k];
+		sums.push_back(sum);
+	}
+	return sums;
+}
+
+
+
+void SmallBenchmark(const char* name, const vector<pair<int, int>>& terms, size_t chain)
+{
+	vector<IntRational> t_int;
+	vector<BigRational> t_big;
+	for ( auto [p, q] : terms )
+	{
+		t_int.emplace_back(p, q);
+		t_big.emplace_back(p, q);
+	}
+	vector<IntRational> s_int;
+	vector<BigRational> s_big;
+	const double sec[] = {
+		TimeSec([&]{ s_int = ChainSums(t_int, chain); }),
+		TimeSec([&]{ s_big = ChainSums(t_big, chain); }) };
+	size_t differ = 0;
+	for ( size_t i = 0; i < s_int.size(); ++i )  differ += ToString(s_int[i]) != ToString(s_big[i]);
+	cout << setw(22) << left << name << right << "  IntRational "
+	     << setw(5) << sec[0] * 1e9 / terms.size() << " ns, BigRational "
+	     << setw(5) << sec[1] * 1e9 / terms.size() << " ns per addition ("
+	     << differ << " of " << s_int.size() << " sums differ)\n";
+}
+
+
+
+Natural RandomNatural(mt19937_64& gen, size_t limbs)
+{
+	Natural x;
+	const Natural base(uint128 {1} << 64);
+	for ( size_t i = 0; i < limbs; ++i )  x = x * base + Natural(gen() | (i == 0));  // Top limb not 0
+	return x;
+}
+
+
+
+// Seconds per call of f(), repeated for 0.1 s at least
+template <typename F>
+double TimeOp(F f)
+{
+	size_t reps = 0;
+	const double sec = TimeSec([&]{
+		const auto start = chrono::steady_clock::now();
+		do  { f(); ++reps; } while ( chrono::steady_clock::now() - start < chrono::milliseconds(100) );
+	});
+	return sec / reps;
+}
+
+
+
+void BigBenchmark()
+{
+	mt19937_64 gen(1);
+	cout << " limbs   schoolbook    Karatsuba  Euclid gcd   Lehmer gcd   BigRational +\n";
+	for ( size_t limbs : {4, 16, 64, 256, 1024} )
+	{
+		const Natural a = RandomNatural(gen, limbs), b = RandomNatural(gen, limbs);
+		const Natural c = RandomNatural(gen, limbs), d = RandomNatural(gen, limbs);
+		Natural r1, r2;
+		const double t1 = TimeOp([&]{ r1 = Schoolbook(a, b); });
+		const double t2 = TimeOp([&]{ r2 = a * b; });
+		if ( !(r1 == r2) )  cout << "products differ\n";
+		const double t3 = TimeOp([&]{ r1 = EuclidGcd(a, b); });
+		const double t4 = TimeOp([&]{ r2 = Gcd(a, b); });
+		if ( !(r1 == r2) )  cout << "gcds differ\n";
+		const BigRational x(false, a, b), y(true, c, d);
+		BigRational z;
+		const double t5 = TimeOp([&]{ z = x + y; });
+		cout << setw(6) << limbs;
+		for ( double t : {t1, t2, t3, t4, t5} )  cout << setw(10) << t * 1e6 << " us";
+		cout << '\n';
+	}
+}
+
+
+
+int main()
+{
+	Demo();
+	cout << '\n' << fixed << setprecision(1);
+
+	const size_t count = 4'000'000, chain = 256;
+	mt19937 gen(1);
+	uniform_int_distribution<int> cents(1, 999);
+	vector<pair<int, int>> terms(count);
+	for ( auto& t : terms )  t = {cents(gen), 100};
+	SmallBenchmark("prices p/100", terms, chain);
+	const int dens[] = {2, 3, 4, 5, 6, 8, 10, 12, 20, 24, 25, 50, 100};  // lcm 600
+	uniform_int_distribution<int> num(1, 99), den(0, size(dens) - 1);
+	for ( auto& t : terms )  t = {num(gen), dens[den(gen)]};
+	SmallBenchmark("mixed denominators", terms, chain);
+	cout << '\n';
+
+	BigBenchmark();
+}
@@ -0,0 +1,497 @@
+/*****************************************************************************
+ * This model program demonstrates SomeClass of ctors_oper=.cpp with its data
+ * array aligned to a cache line and a family of bulk operations on it:
+ * fill, transform, reduce and compare run over whole SIMD vectors, large
+ * outputs are written with non-temporal stores that bypass the caches, and
+ * the output operator formats all elements with to_chars into one buffer.
+ * g++ bulk_operations.cpp -std=c++20 -O3 -march=native -o bulk_operations
+ *****************************************************************************/
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <new>
+#include <stdexcept>
+#include <streambuf>
+#include <string>
+#include <utility>
+#include <vector>
+#include <unistd.h>
+#include <immintrin.h>
+
+using namespace std;
+
+using Size = uint32_t;
+using Data = int;
+
+
+
+// The class of ctors_oper=.cpp without the output of every call, kept as the
+// baseline, with its operations written as plain element loops
+
+class NewSomeClass
+{
+public:
+	explicit NewSomeClass(Size size) : size_ {size}, p_data_ {new Data[size_]} {}
+	NewSomeClass(const NewSomeClass& other)
+		: size_ {other.size_}, p_data_ {new Data[other.size_]}, name_ {other.name_}
+	{
+		memcpy(p_data_, other.p_data_, sizeof(Data) * size_);
+	}
+	~NewSomeClass() { delete[] p_data_; }
+	const NewSomeClass& operator =(const NewSomeClass&) = delete;
+
+	const NewSomeClass& DoSomething(Data value)
+	{
+		for ( Size i = 0; i < size_; ++i )  p_data_[i] = value;
+		return *this;
+	}
+	template <typename F>
+	const NewSomeClass& Transform(const NewSomeClass& other, F f)
+	{
+		for ( Size i = 0; i < size_; ++i )  p_data_[i] = f(other.p_data_[i]);
+		return *this;
+	}
+	int64_t Sum() const
+	{
+		int64_t sum = 0;
+		for ( Size i = 0; i < size_; ++i )  sum += p_data_[i];
+		return sum;
+	}
+	Size Mismatch(const NewSomeClass& other) const
+	{
+		Size i = 0;
+		while ( i < size_ && p_data_[i] == other.p_data_[i] )  ++i;
+		return i;
+	}
+
+private:
+	Size size_ = 0;
+	Data* p_data_ = nullptr;
+	string name_ = "DefaultName";
+
+	friend ostream& operator <<(ostream& out, const NewSomeClass& sc)
+	{
+		out << sc.name_ << ":";
+		if ( sc.size_ == 0 )  out << " empty";
+		for ( Size i = 0; i < sc.size_; ++i )  out << ' ' << sc.p_data_[i];
+		return out;
+	}
+};
+
+
+
+//-----------------------------------------------------------------------------
+
+
+// GCC/Clang vector extension, as wide as the registers of the target: a
+// wider vector returned by value would be passed in memory, and GCC warns
+// that this changes the ABI. Arithmetic and comparisons work lane by lane,
+// so the same lambda can transform a Data and a Vec.
+#if defined(__AVX512F__)
+constexpr size_t vector_bytes = 64;
+#elif defined(__AVX__)
+constexpr size_t vector_bytes = 32;
+#else
+constexpr size_t vector_bytes = 16;
+#endif
+using Vec = Data __attribute__((vector_size(vector_bytes)));
+
+constexpr size_t lanes = sizeof(Vec) / sizeof(Data);
+constexpr size_t line_size = 64;
+
+inline Vec Load(const Data* p) { return *reinterpret_cast<const Vec*>(p); }  // p aligned
+inline void Store(Data* p, Vec v) { *reinterpret_cast<Vec*>(p) = v; }
+
+// A non-temporal store writes to memory without reading the line first
+// and without evicting other data from the caches; the stores of a line
+// are combined into one write. Each must be followed by StreamFence()
+// before the data is read again.
+inline void StreamStore(Data* p, Vec v)
+{
+#if defined(__AVX512F__)
+	_mm512_stream_si512(reinterpret_cast<__m512i*>(p), reinterpret_cast<__m512i>(v));
+#elif defined(__AVX__)
+	_mm256_stream_si256(reinterpret_cast<__m256i*>(p), reinterpret_cast<__m256i>(v));
+#else
+	_mm_stream_si128(reinterpret_cast<__m128i*>(p), reinterpret_cast<__m128i>(v));
+#endif
+}
+
+inline void StreamFence() { _mm_sfence(); }
+
+inline bool AnyNonZero(Vec v)
+{
+	uint64_t words[sizeof(Vec) / sizeof(uint64_t)];
+	memcpy(words, &v, sizeof(v));
+	uint64_t any = 0;
+	for ( uint64_t w : words )  any |= w;
+	return any != 0;
+}
+
+
+
+// Outputs larger than half of the last-level cache would only evict data
+// that is still needed, so they are streamed to memory
+size_t NonTemporalBytes()
+{
+	static const size_t bytes = []
+	{
+		long llc = 0;
+#ifdef _SC_LEVEL3_CACHE_SIZE
+		llc = sysconf(_SC_LEVEL3_CACHE_SIZE);
+#endif
+		return llc > 0 ? static_cast<size_t>(llc) / 2 : size_t {8} << 20;
+	}();
+	return bytes;
+}
+
+
+
+//-----------------------------------------------------------------------------
+
+
+// p_data_ starts a cache line, so that every full vector of the kernels is
+// one aligned load or store; only the last size_ % lanes elements take the
+// scalar loop.
+class SomeClass
+{
+public:
+	SomeClass() = delete;
+	explicit SomeClass(Size size);
+	SomeClass(Size size, const string& name);
+	SomeClass(const SomeClass& other);
+	SomeClass(SomeClass&& other) noexcept;
+
+	~SomeClass() { Free(p_data_); }
+
+	const SomeClass& operator =(const SomeClass& other);
+	const SomeClass& operator =(SomeClass&& other) noexcept;
+
+	const SomeClass& DoSomething(Data value);  // Fill
+
+	// this[i] = f(other[i]), where f takes both Data and Vec; other may be *this
+	template <typename F> const SomeClass& Transform(const SomeClass& other, F f);
+	int64_t Sum() const;
+	pair<Data, Data> MinMax() const;         // {max, min} of Data if empty
+	Size Mismatch(const SomeClass& other) const;  // First index that differs
+	bool Equal(const SomeClass& other) const
+	{
+		return size_ == other.size_ && Mismatch(other) == size_;
+	}
+
+private:
+	Size size_ = 0;
+	Data* p_data_ = nullptr;
+	string name_ = "DefaultName";
+
+	static Data* Allocate(Size size)
+	{
+		return static_cast<Data*>(::operator new[](sizeof(Data) * size, align_val_t {line_size}));
+	}
+	static void Free(Data* p) { ::operator delete[](p, align_val_t {line_size}); }
+
+	friend ostream& operator <<(ostream& out, const SomeClass& sc);
+};
+
+
+
+SomeClass::SomeClass(Size size)
+	: size_ {size}, p_data_ {Allocate(size)}
+{
+}
+
+
+
+SomeClass::SomeClass(Size size, const string& name)
+	: size_ {size}, p_data_ {Allocate(size)}, name_ {name}
+{
+}
+
+
+
+SomeClass::SomeClass(const SomeClass& other)
+	: size_ {other.size_}, p_data_ {Allocate(other.size_)}, name_ {other.name_}
+{
+	memcpy(p_data_, other.p_data_, sizeof(Data) * size_);
+}
+
+
+
+SomeClass::SomeClass(SomeClass&& other) noexcept
+	: size_ {other.size_}, p_data_ {other.p_data_}, name_ {move(other.name_)}
+{
+	other.size_ = 0;
+	other.p_data_ = nullptr;
+}
+
+
+
+const SomeClass& SomeClass::operator =(const SomeClass& other)
+{
+	if ( &other != this )
+	{
+		Free(p_data_);
+		size_ = other.size_;
+		p_data_ = Allocate(size_);
+		name_ = other.name_;
+		memcpy(p_data_, other.p_data_, sizeof(Data) * size_);
+	}
+	return *this;
+}
+
+
+
+const SomeClass& SomeClass::operator =(SomeClass&& other) noexcept
+{
+	if ( &other != this )
+	{
+		Free(p_data_);
+		size_ = other.size_;
+		p_data_ = other.p_data_;
+		name_ = move(other.name_);
+		other.size_ = 0;
+		other.p_data_ = nullptr;
+	}
+	return *this;
+}
+
+
+
+const SomeClass& SomeClass::DoSomething(Data value)
+{
+	const Vec v = Vec {} + value;
+	const Size body = size_ - size_ % lanes;
+	if ( sizeof(Data) * size_ >= NonTemporalBytes() )
+	{
+		for ( Size i = 0; i < body; i += lanes )  StreamStore(p_data_ + i, v);
+		StreamFence();
+	}
+	else
+		for ( Size i = 0; i < body; i += lanes )  Store(p_data_ + i, v);
+	for ( Size i = body; i < size_; ++i )  p_data_[i] = value;
+	return *this;
+}
+
+
+
+template <typename F>
+const SomeClass& SomeClass::Transform(const SomeClass& other, F f)
+{
+	if ( other.size_ != size_ )  throw invalid_argument("SomeClass: sizes do not match");
+	const Data* src = other.p_data_;
+	const Size body = size_ - size_ % lanes;
+	if ( sizeof(Data) * size_ >= NonTemporalBytes() && src != p_data_ )
+	{
+		for ( Size i = 0; i < body; i += lanes )  StreamStore(p_data_ + i, f(Load(src + i)));
+		StreamFence();
+	}
+	else
+		for ( Size i = 0; i < body; i += lanes )  Store(p_data_ + i, f(Load(src + i)));
+	for ( Size i = body; i < size_; ++i )  p_data_[i] = f(src[i]);
+	return *this;
+}
+
+
+
+// Elements are widened to 64 bits, so the sum cannot overflow for any size.
+// GCC vectorizes this loop by itself at -O3 (it has no stores that could
+// change size_), and the widening is better left to it than written with Vec.
+int64_t SomeClass::Sum() const
+{
+	const Data* p = static_cast<const Data*>(__builtin_assume_aligned(p_data_, line_size));
+	int64_t sum = 0;
+	for ( Size i = 0; i < size_; ++i )  sum += p[i];
+	return sum;
+}
+
+
+
+pair<Data, Data> SomeClass::MinMax() const
+{
+	const Size body = size_ - size_ % lanes;
+	Vec lo = Vec {} + numeric_limits<Data>::max(), hi = Vec {} + numeric_limits<Data>::min();
+	for ( Size i = 0; i < body; i += lanes )
+	{
+		const Vec v = Load(p_data_ + i);
+		lo = v < lo ? v : lo;
+		hi = v > hi ? v : hi;
+	}
+	Data min_value = numeric_limits<Data>::max(), max_value = numeric_limits<Data>::min();
+	for ( size_t k = 0; k < lanes; ++k )
+	{
+		min_value = min(min_value, lo[k]);
+		max_value = max(max_value, hi[k]);
+	}
+	for ( Size i = body; i < size_; ++i )
+	{
+		min_value = min(min_value, p_data_[i]);
+		max_value = max(max_value, p_data_[i]);
+	}
+	return {min_value, max_value};
+}
+
+
+
+// Four vectors are tested at once, and only a block that differs is
+// searched element by element
+Size SomeClass::Mismatch(const SomeClass& other) const
+{
+	const Size size = min(size_, other.size_);
+	const Data* a = p_data_;
+	const Data* b = other.p_data_;
+	const Size block = 4 * lanes;
+	Size i = 0;
+	for ( ; i + block <= size; i += block )
+	{
+		const Vec diff = (Load(a + i) ^ Load(b + i)) | (Load(a + i + lanes) ^ Load(b + i + lanes))
+		               | (Load(a + i + 2 * lanes) ^ Load(b + i + 2 * lanes))
+		               | (Load(a + i + 3 * lanes) ^ Load(b + i + 3 * lanes));
+		if ( AnyNonZero(diff) )  break;
+	}
+	while ( i < size && a[i] == b[i] )  ++i;
+	return i;
+}
+
+
+
+// to_chars into a buffer that is written to the stream when nearly full:
+// one write() per 4 KB instead of a formatted insertion per element
+ostream& operator <<(ostream& out, const SomeClass& sc)
+{
+	out << sc.name_ << ":";
+	if ( sc.size_ == 0 )  return out << " empty";
+	char buffer[4096];
+	char* p = buffer;
+	constexpr size_t max_chars = 1 + numeric_limits<Data>::digits10 + 2;  // Space, digits, sign
+	for ( Size i = 0; i < sc.size_; ++i )
+	{
+		if ( buffer + sizeof(buffer) - p < static_cast<ptrdiff_t>(max_chars) )
+		{
+			out.write(buffer, p - buffer);
+			p = buffer;
+		}
+		*p++ = ' ';
+		p = to_chars(p, buffer + sizeof(buffer), sc.p_data_[i]).ptr;
+	}
+	return out.write(buffer, p - buffer);
+}
+
+
+
+//-----------------------------------------------------------------------------
+
+
+template <typename F>
+double TimeSec(F f)
+{
+	const auto t = chrono::steady_clock::now();
+	f();
+	return chrono::duration<double>(chrono::steady_clock::now() - t).count();
+}
+
+
+
+// Counts the characters written to it and drops them, so that the output
+// benchmark measures formatting rather than a terminal or a file
+class NullBuffer : public streambuf
+{
+public:
+	size_t count = 0;
+
+protected:
+	int_type overflow(int_type ch) override { ++count; return traits_type::not_eof(ch); }
+	streamsize xsputn(const char*, streamsize n) override { count += n; return n; }
+};
+
+
+
+void Demo()
+{
+	SomeClass a(37, "A"), b(37, "B");
+	a.DoSomething(2);
+	b.Transform(a, [](auto x) { return x * 3 - 1; });
+	cout << a << '\n' << b << '\n';
+	const auto [lo, hi] = b.MinMax();
+	cout << "Sum " << b.Sum() << ", min " << lo << ", max " << hi;
+	SomeClass c(b);
+	cout << ", copy equal " << c.Equal(b);
+	c.Transform(c, [](auto x) { return x + 1; });
+	cout << ", mismatch after +1 at " << b.Mismatch(c) << "\n\n";
+}
+
+
+
+// Keeps the compiler from computing Sum() and Mismatch() of unchanged data
+// once for all the repeats
+inline void Clobber() { asm volatile("" ::: "memory"); }  // GCC extension
+
+
+
+template <typename T>
+void Benchmark(Size size, double (&sec)[5], size_t& chars)
+{
+	const int repeats = static_cast<int>(max<size_t>(1, (size_t {64} << 20) / size));
+	T a(size), b(size);
+	a.DoSomething(0);  // The first touch of fresh pages costs more than the fill
+	b.DoSomething(0);
+	auto f = [](auto x) { return x * 3 - 1; };
+	int64_t sum = 0;
+	sec[0] = TimeSec([&]{ for ( int r = 0; r < repeats; ++r )  a.DoSomething(r); });
+	sec[1] = TimeSec([&]{ for ( int r = 0; r < repeats; ++r )  b.Transform(a, f); });
+	sec[2] = TimeSec([&]{ for ( int r = 0; r < repeats; ++r ) { Clobber(); sum += b.Sum(); } });
+	const T c(a);
+	Size mismatch = 0;
+	sec[3] = TimeSec([&]{
+		for ( int r = 0; r < repeats; ++r ) { Clobber(); mismatch += a.Mismatch(c); }
+	});
+	if ( sum == 0 || mismatch == 0 )  cout << "  (unexpected result)\n";
+	sec[4] = 0;
+	if ( size <= (1 << 20) )
+	{
+		NullBuffer null;
+		ostream out(&null);
+		sec[4] = TimeSec([&]{ out << b; });
+		chars = null.count;
+	}
+	for ( int k = 0; k < 4; ++k )  sec[k] /= repeats;
+}
+
+
+
+void Benchmark()
+{
+	cout << "GB/s of the data (new[] loops / bulk):  fill, transform, sum, mismatch;"
+	     << " output in M elements/s\n";
+	for ( Size size : {1u << 10, 1u << 14, 1u << 18, 1u << 22, 1u << 25} )
+	{
+		double sec[2][5];
+		size_t chars[2] = {};
+		Benchmark<NewSomeClass>(size, sec[0], chars[0]);
+		Benchmark<SomeClass>(size, sec[1], chars[1]);
+		const double bytes = sizeof(Data) * size;
+		cout << setw(8) << bytes / 1024 << " KB:";
+		const double traffic[] = {bytes, 2 * bytes, bytes, 2 * bytes};
+		for ( int k = 0; k < 4; ++k )
+			cout << setw(7) << traffic[k] / sec[0][k] / 1e9 << " /" << setw(6)
+			     << traffic[k] / sec[1][k] / 1e9;
+		if ( sec[0][4] > 0 )
+			cout << "   " << setw(5) << size / sec[0][4] / 1e6 << " /" << setw(6) << size / sec[1][4] / 1e6
+			     << (chars[0] == chars[1] ? "" : " (outputs differ)");
+		cout << '\n';
+	}
+}
+
+
+
+int main()
+{
+	Demo();
+	cout << fixed << setprecision(1);
+	Benchmark();
+}
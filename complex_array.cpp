@@ -0,0 +1,451 @@
+/*****************************************************************************
+ * This model program demonstrates a structure-of-arrays container of complex
+ * numbers: real and imaginary parts are stored in separate arrays, so that
+ * element-wise operations vectorize without shuffles.
+ * g++ complex_array.cpp -std=c++20 -O3 -march=native -o complex_array
+ *****************************************************************************/
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <numbers>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+using namespace std;
+
+
+
+template <typename... Sizes>
+void CheckSizes(size_t size, Sizes... sizes)
+{
+	if ( ((sizes != size) || ...) )  throw invalid_argument("ComplexArray: sizes do not match");
+}
+
+
+
+template <typename T>
+class ComplexArray
+{
+public:
+	using value_type = complex<T>;
+
+	ComplexArray() = default;
+	explicit ComplexArray(size_t size) : re_(size), im_(size) {}
+	explicit ComplexArray(span<const complex<T>> interleaved);
+
+	size_t size() const { return re_.size(); }
+	complex<T> operator [](size_t i) const { return {re_[i], im_[i]}; }
+	void Set(size_t i, complex<T> z) { re_[i] = z.real(); im_[i] = z.imag(); }
+	span<T> Real() { return re_; }
+	span<T> Imag() { return im_; }
+	span<const T> Real() const { return re_; }
+	span<const T> Imag() const { return im_; }
+
+	void ToInterleaved(span<complex<T>> out) const;
+	vector<complex<T>> ToInterleaved() const;
+
+private:
+	vector<T> re_;
+	vector<T> im_;
+};
+
+
+
+// complex<T> is guaranteed to have the layout of T[2], so the conversions
+// are plain loops over an array of reals.
+template <typename T>
+ComplexArray<T>::ComplexArray(span<const complex<T>> interleaved)
+	: ComplexArray(interleaved.size())
+{
+	const T* p = reinterpret_cast<const T*>(interleaved.data());
+	for ( size_t i = 0; i < size(); ++i )
+	{
+		re_[i] = p[2 * i];
+		im_[i] = p[2 * i + 1];
+	}
+}
+
+
+
+template <typename T>
+void ComplexArray<T>::ToInterleaved(span<complex<T>> out) const
+{
+	CheckSizes(size(), out.size());
+	T* p = reinterpret_cast<T*>(out.data());
+	for ( size_t i = 0; i < size(); ++i )
+	{
+		p[2 * i] = re_[i];
+		p[2 * i + 1] = im_[i];
+	}
+}
+
+
+
+template <typename T>
+vector<complex<T>> ComplexArray<T>::ToInterleaved() const
+{
+	vector<complex<T>> out(size());
+	ToInterleaved(out);
+	return out;
+}
+
+
+
+// A power of two s such that m * s lies in [1/4, 1) for a normal m >= 0,
+// taken from the exponent bits of m; subnormal m, infinities and NaN get
+// the largest or smallest normal power. Scaling by s is exact, so Abs() and
+// Sqrt() square scaled values, which can neither overflow nor underflow,
+// and scale back at the end; Divide() scales a tiny divisor. With 'even' the exponent of s is
+// even, so that sqrt(s) is exact too. Integer selects only: it vectorizes.
+template <typename T>
+T ScaleFor(T m, bool even = false)
+{
+	static_assert(is_same_v<T, float> || is_same_v<T, double>);
+	using U = conditional_t<is_same_v<T, float>, uint32_t, uint64_t>;
+	using S = make_signed_t<U>;
+	constexpr int mantissa = numeric_limits<T>::digits - 1;
+	constexpr S bias = numeric_limits<T>::max_exponent - 1;
+	const S e = static_cast<S>(bit_cast<U>(m) >> mantissa);  // m >= 0: no sign bit
+	S se = clamp<S>(2 * bias - 1 - e, 1, 2 * bias);
+	if ( even )  se -= (se - bias) & 1;
+	return bit_cast<T>(static_cast<U>(se) << mantissa);
+}
+
+
+
+// Kernels write into a preallocated result, which may be one of the
+// arguments. The formulas below do not follow the C99 Annex G rules for
+// infinities and NaNs the way operator* of complex<T> does (that is what
+// makes it call __muldc3); for finite values they agree with complex<T> to
+// a few ulps. Divide() uses Smith's algorithm, and Abs() and Sqrt() scale
+// their arguments by a power of two as hypot() does, so that all three stay
+// accurate near the overflow and underflow thresholds.
+
+template <typename T>
+void Multiply(const ComplexArray<T>& a, const ComplexArray<T>& b, ComplexArray<T>& out)
+{
+	CheckSizes(a.size(), b.size(), out.size());
+	const T* are = a.Real().data();
+	const T* aim = a.Imag().data();
+	const T* bre = b.Real().data();
+	const T* bim = b.Imag().data();
+	T* re = out.Real().data();
+	T* im = out.Imag().data();
+	for ( size_t i = 0; i < out.size(); ++i )
+	{
+		const T r = are[i] * bre[i] - aim[i] * bim[i];
+		const T m = are[i] * bim[i] + aim[i] * bre[i];
+		re[i] = r;
+		im[i] = m;
+	}
+}
+
+
+
+template <typename T>
+void Divide(const ComplexArray<T>& a, const ComplexArray<T>& b, ComplexArray<T>& out)
+{
+	CheckSizes(a.size(), b.size(), out.size());
+	const T* are = a.Real().data();
+	const T* aim = a.Imag().data();
+	const T* bre = b.Real().data();
+	const T* bim = b.Imag().data();
+	T* re = out.Real().data();
+	T* im = out.Imag().data();
+	for ( size_t i = 0; i < out.size(); ++i )
+	{
+		// Smith's algorithm: no squares, so no overflow or underflow unless
+		// the result itself does. (a + bi) / (c + di) with |c| >= |d| is
+		// ((a + b r) + (b - a r) i) / (c + d r) for r = d / c; with |d| > |c|
+		// the roles of c and d and of a and b swap, and the sign of the
+		// imaginary part flips. A small divisor is scaled up by s and a small
+		// dividend by t, so that neither c + d r nor the numerators lose
+		// significant bits to subnormal numbers; s / t is exact, and the
+		// quotient is scaled by it last, so it overflows only if it must.
+		const bool c_larger = abs(bre[i]) >= abs(bim[i]);
+		const T p = c_larger ? bre[i] : bim[i], q = c_larger ? bim[i] : bre[i];
+		const T x = c_larger ? are[i] : aim[i], y = c_larger ? aim[i] : are[i];
+		const T s = max(ScaleFor(abs(p)), T {1});
+		const T t = max(ScaleFor(max(abs(x), abs(y))), T {1});
+		const T ratio = q / p;
+		const T den = p * s + q * s * ratio;
+		const T r = (x * t + y * t * ratio) / den * (s / t);
+		const T m = (y * t - x * t * ratio) / den * (s / t);
+		re[i] = r;
+		im[i] = c_larger ? m : -m;
+	}
+}
+
+
+
+template <typename T>
+void Conj(const ComplexArray<T>& z, ComplexArray<T>& out)
+{
+	CheckSizes(z.size(), out.size());
+	const auto re = z.Real(), im = z.Imag();
+	auto ore = out.Real(), oim = out.Imag();
+	for ( size_t i = 0; i < z.size(); ++i )
+	{
+		ore[i] = re[i];
+		oim[i] = -im[i];
+	}
+}
+
+
+
+// hypot() does not vectorize; the scaled sqrt(x^2 + y^2) does
+template <typename T>
+void Abs(const ComplexArray<T>& z, span<T> out)
+{
+	CheckSizes(z.size(), out.size());
+	const auto re = z.Real(), im = z.Imag();
+	for ( size_t i = 0; i < z.size(); ++i )
+	{
+		const T s = ScaleFor(max(abs(re[i]), abs(im[i])));
+		const T x = re[i] * s, y = im[i] * s;
+		out[i] = sqrt(x * x + y * y) / s;
+	}
+}
+
+
+
+template <typename T>
+void Arg(const ComplexArray<T>& z, span<T> out)
+{
+	CheckSizes(z.size(), out.size());
+	const auto re = z.Real(), im = z.Imag();
+	for ( size_t i = 0; i < z.size(); ++i )  out[i] = atan2(im[i], re[i]);
+}
+
+
+
+template <typename T>
+void Exp(const ComplexArray<T>& z, ComplexArray<T>& out)
+{
+	CheckSizes(z.size(), out.size());
+	const auto re = z.Real(), im = z.Imag();
+	auto ore = out.Real(), oim = out.Imag();
+	for ( size_t i = 0; i < z.size(); ++i )
+	{
+		const T m = exp(re[i]), y = im[i];
+		ore[i] = m * cos(y);
+		oim[i] = m * sin(y);
+	}
+}
+
+
+
+// Principal square root with the branch cut along the negative real axis:
+// the sign of the imaginary part (including -0.0) selects the side of the
+// cut, exactly as sqrt(complex<T>(-4, -0.0)) does. Branches are written as
+// selects, so the loop still vectorizes.
+template <typename T>
+void Sqrt(const ComplexArray<T>& z, ComplexArray<T>& out)
+{
+	CheckSizes(z.size(), out.size());
+	const auto re = z.Real(), im = z.Imag();
+	auto ore = out.Real(), oim = out.Imag();
+	for ( size_t i = 0; i < z.size(); ++i )
+	{
+		const T x = re[i], y = im[i];
+		const T s = ScaleFor(max(abs(x), abs(y)), true);
+		const T xs = x * s, ys = y * s;
+		const T t = sqrt((sqrt(xs * xs + ys * ys) + abs(xs)) / 2) / sqrt(s);
+		const T half_y = (t == 0) ? y : y / (2 * t);
+		ore[i] = (x >= 0) ? t : abs(half_y);
+		oim[i] = (x >= 0) ? half_y : copysign(t, y);
+	}
+}
+
+
+
+// Value-returning forms, as for complex<T>
+
+template <typename T>
+const ComplexArray<T> operator *(const ComplexArray<T>& lhs, const ComplexArray<T>& rhs)
+{
+	ComplexArray<T> r(lhs.size());
+	Multiply(lhs, rhs, r);
+	return r;
+}
+
+template <typename T>
+const ComplexArray<T> operator /(const ComplexArray<T>& lhs, const ComplexArray<T>& rhs)
+{
+	ComplexArray<T> r(lhs.size());
+	Divide(lhs, rhs, r);
+	return r;
+}
+
+template <typename T>
+ComplexArray<T> conj(const ComplexArray<T>& z) { ComplexArray<T> r(z.size()); Conj(z, r); return r; }
+
+template <typename T>
+vector<T> abs(const ComplexArray<T>& z) { vector<T> r(z.size()); Abs(z, span(r)); return r; }
+
+template <typename T>
+vector<T> arg(const ComplexArray<T>& z) { vector<T> r(z.size()); Arg(z, span(r)); return r; }
+
+template <typename T>
+ComplexArray<T> exp(const ComplexArray<T>& z) { ComplexArray<T> r(z.size()); Exp(z, r); return r; }
+
+template <typename T>
+ComplexArray<T> sqrt(const ComplexArray<T>& z) { ComplexArray<T> r(z.size()); Sqrt(z, r); return r; }
+
+
+
+template <typename F>
+double TimeMs(F f)
+{
+	const auto t = chrono::steady_clock::now();
+	f();
+	return chrono::duration<double, milli>(chrono::steady_clock::now() - t).count();
+}
+
+
+
+// Relative differences from complex<T> for parts of every binary exponent,
+// from subnormal to near the overflow threshold, in random combinations
+template <typename T>
+void ExtremeValues(const string& type)
+{
+	mt19937 gen(7);
+	using limits = numeric_limits<T>;
+	uniform_int_distribution<int> exponent(limits::min_exponent - limits::digits,
+	                                       limits::max_exponent - 1);
+	uniform_real_distribution<T> mantissa(-1, 1);
+	auto value = [&] { return ldexp(mantissa(gen), exponent(gen)); };
+	const size_t count = 100'000;
+	vector<complex<T>> a(count), b(count);
+	for ( size_t i = 0; i < count; ++i )
+	{
+		a[i] = {value(), value()};
+		b[i] = {value(), value()};
+	}
+	const ComplexArray<T> sa(a), sb(b);
+	const ComplexArray<T> quotients = sa / sb, roots = sqrt(sa);
+	const vector<T> moduli = abs(sa);
+	// Results beyond the normal range are compared as absolute differences
+	auto diff = [](complex<T> expected, complex<T> got)
+	{
+		if ( isinf(std::abs(expected)) )  return T(isinf(std::abs(got)) ? 0 : 1);
+		return std::abs(expected - got) / max(limits::min(), std::abs(expected));
+	};
+	T div = 0, mod = 0, root = 0;
+	for ( size_t i = 0; i < count; ++i )
+	{
+		// Parts below 2^-150 round to 0, and division by 0 is not finite
+		if ( b[i] != complex<T> {} )  div = max(div, diff(a[i] / b[i], quotients[i]));
+		mod = max(mod, diff(std::abs(a[i]), moduli[i]));
+		root = max(root, diff(std::sqrt(a[i]), roots[i]));
+	}
+	cout << type << " parts from 2^" << exponent.a() << " to 2^" << exponent.b()
+	     << ": max rel. diff / " << scientific << div << ", abs " << mod << ", sqrt "
+	     << root << fixed << '\n';
+}
+
+
+
+template <typename T>
+void Benchmark(const string& type, size_t count)
+{
+	mt19937 gen(42);
+	uniform_real_distribution<T> distr(-10, 10);
+	vector<complex<T>> a(count), b(count), c(count);
+	for ( size_t i = 0; i < count; ++i )
+	{
+		a[i] = {distr(gen), distr(gen)};
+		b[i] = {distr(gen), distr(gen)};
+	}
+	const ComplexArray<T> sa(a), sb(b);
+	ComplexArray<T> sc(count);
+	vector<T> r(count), sr(count);
+	T err = 0;
+	auto check = [&](const vector<complex<T>>& expected, const ComplexArray<T>& got)
+	{
+		err = 0;
+		for ( size_t i = 0; i < count; ++i )
+			err = max(err, std::abs(expected[i] - got[i]) / max(T {1}, std::abs(expected[i])));
+	};
+	auto row = [&](const char* op, double t1, double t2)
+	{
+		cout << type << setw(6) << op << ":  vector<complex> " << setw(6) << t1
+		     << " ms, ComplexArray " << setw(6) << t2 << " ms, max rel. diff "
+		     << scientific << err << fixed << '\n';
+	};
+
+	double t1 = TimeMs([&]{ for ( size_t i = 0; i < count; ++i )  c[i] = a[i] * b[i]; });
+	double t2 = TimeMs([&]{ Multiply(sa, sb, sc); });
+	check(c, sc);
+	row("*", t1, t2);
+
+	t1 = TimeMs([&]{ for ( size_t i = 0; i < count; ++i )  c[i] = a[i] / b[i]; });
+	t2 = TimeMs([&]{ Divide(sa, sb, sc); });
+	check(c, sc);
+	row("/", t1, t2);
+
+	t1 = TimeMs([&]{ for ( size_t i = 0; i < count; ++i )  r[i] = std::abs(a[i]); });
+	t2 = TimeMs([&]{ Abs(sa, span(sr)); });
+	err = 0;
+	for ( size_t i = 0; i < count; ++i )  err = max(err, std::abs(r[i] - sr[i]) / r[i]);
+	row("abs", t1, t2);
+
+	t1 = TimeMs([&]{ for ( size_t i = 0; i < count; ++i )  r[i] = std::arg(a[i]); });
+	t2 = TimeMs([&]{ Arg(sa, span(sr)); });
+	err = 0;
+	for ( size_t i = 0; i < count; ++i )  err = max(err, std::abs(r[i] - sr[i]));
+	row("arg", t1, t2);
+
+	t1 = TimeMs([&]{ for ( size_t i = 0; i < count; ++i )  c[i] = std::exp(a[i]); });
+	t2 = TimeMs([&]{ Exp(sa, sc); });
+	check(c, sc);
+	row("exp", t1, t2);
+
+	t1 = TimeMs([&]{ for ( size_t i = 0; i < count; ++i )  c[i] = std::sqrt(a[i]); });
+	t2 = TimeMs([&]{ Sqrt(sa, sc); });
+	check(c, sc);
+	row("sqrt", t1, t2);
+
+	t1 = TimeMs([&]{ for ( size_t i = 0; i < count; ++i )  c[i] = std::conj(a[i]); });
+	t2 = TimeMs([&]{ Conj(sa, sc); });
+	check(c, sc);
+	row("conj", t1, t2);
+}
+
+
+
+int main()
+{
+	const vector<complex<double>> v {{-4, 0}, {-4, -0.0}, {1, 2}, {0, 0}, {-3.25, 1.4}};
+	const ComplexArray<double> z(v);
+	const ComplexArray<double> roots = sqrt(z);
+	cout << fixed << setprecision(2);
+	for ( size_t i = 0; i < z.size(); ++i )
+		cout << "sqrt" << z[i] << " = " << roots[i] << "  (std: " << sqrt(v[i]) << ")\n";
+	const auto products = (z * conj(z)).ToInterleaved();
+	cout << "z * conj(z): ";
+	for ( const auto& p : products )  cout << p << ' ';
+	cout << '\n';
+	ComplexArray<double> euler(1);
+	euler.Set(0, {0, numbers::pi});
+	cout << "exp(pi * i) = " << exp(euler)[0] << "\n\n";
+
+	ExtremeValues<float>("float ");
+	ExtremeValues<double>("double");
+	cout << '\n';
+
+	Benchmark<float>("float ", 4'000'000);
+	cout << '\n';
+	Benchmark<double>("double", 4'000'000);
+}
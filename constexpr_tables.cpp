@@ -0,0 +1,369 @@
+/*****************************************************************************
+ * This model program demonstrates math lookup tables, Chebyshev coefficients
+ * and polynomial evaluators generated at compile time, so that hot loops do a
+ * table lookup plus a short Horner step without any startup initialization.
+ * g++ constexpr_tables.cpp -std=c++20 -O2 -o constexpr_tables
+ * The cost of compile-time generation can be seen by changing the table size:
+ * time g++ constexpr_tables.cpp -std=c++20 -O2 -DSIN_TABLE_SIZE=16384
+ *****************************************************************************/
+
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <numbers>
+#include <random>
+#include <vector>
+
+#ifndef SIN_TABLE_SIZE
+#define SIN_TABLE_SIZE 256
+#endif
+
+#ifndef EXP_TABLE_SIZE
+#define EXP_TABLE_SIZE 64
+#endif
+
+using namespace std;
+
+
+
+// Functions of <cmath> are not constexpr in C++20, so the tables are built
+// with these series. They are accurate to a few ulp on the reduced ranges.
+
+constexpr double ConstAbs(double x) { return x < 0 ? -x : x; }
+
+constexpr long long ConstRound(double x)
+{
+	return static_cast<long long>(x < 0 ? x - 0.5 : x + 0.5);
+}
+
+constexpr double ConstSin(double x)
+{
+	x -= ConstRound(x / (2 * numbers::pi)) * 2 * numbers::pi;  // [-pi, pi]
+	double term = x, sum = x;
+	for ( int n = 1; ConstAbs(term) > 1e-18; ++n )
+	{
+		term *= -x * x / ((2 * n) * (2 * n + 1));
+		sum += term;
+	}
+	return sum;
+}
+
+constexpr double ConstCos(double x)
+{
+	return ConstSin(x + numbers::pi / 2);
+}
+
+constexpr double ConstExp(double x)
+{
+	const long long k = ConstRound(x / numbers::ln2);  // x = k ln2 + r
+	const double r = x - k * numbers::ln2;
+	double term = 1, sum = 1;
+	for ( int n = 1; ConstAbs(term) > 1e-18; ++n )
+	{
+		term *= r / n;
+		sum += term;
+	}
+	for ( long long i = 0; i < k; ++i )  sum *= 2;
+	for ( long long i = 0; i > k; --i )  sum /= 2;
+	return sum;
+}
+
+constexpr double zeta_2 = numbers::pi * numbers::pi / 6;  // Instead of pow(acos(-1), 2)/6
+static_assert(ConstAbs(ConstSin(numbers::pi / 6) - 0.5) < 1e-15);
+static_assert(ConstAbs(ConstExp(1) - numbers::e) < 1e-15);
+
+
+
+//-----------------------------------------------------------------------------
+
+
+// sin and cos at N points of [0, 2pi). N must be a power of two.
+template <size_t N>
+struct SinCosTable
+{
+	static_assert((N & (N - 1)) == 0, "Table size must be a power of two");
+	static constexpr double step = 2 * numbers::pi / N;
+	array<double, N> sin {};
+	array<double, N> cos {};
+};
+
+template <size_t N>
+constexpr SinCosTable<N> MakeSinCosTable()
+{
+	SinCosTable<N> t;
+	for ( size_t i = 0; i < N; ++i )
+	{
+		t.sin[i] = ConstSin(i * t.step);
+		t.cos[i] = ConstCos(i * t.step);
+	}
+	return t;
+}
+
+template <size_t N>
+constexpr SinCosTable<N> sin_cos_table = MakeSinCosTable<N>();  // Lives in .rodata
+
+
+
+// 2^(i/N) for i in [0, N)
+template <size_t N>
+constexpr array<double, N> MakeExp2Table()
+{
+	array<double, N> t {};
+	for ( size_t i = 0; i < N; ++i )  t[i] = ConstExp(numbers::ln2 * i / N);
+	return t;
+}
+
+template <size_t N>
+constexpr array<double, N> exp2_table = MakeExp2Table<N>();
+
+
+
+// |x| >= 2^20 or NaN: k step would need more bits than the split step has
+[[gnu::noinline, gnu::cold]] inline void TableSinCosOutside(double x, double& s, double& c)
+{
+	s = sin(x);
+	c = cos(x);
+}
+
+
+
+// x = k * step + d with |d| <= step/2, then
+// sin(x) = sin(k step) cos(d) + cos(k step) sin(d) with short series in d.
+// 2pi/N is split into three parts (Cody and Waite): hi has 21 significant
+// bits, so that k hi is exact, and lo is the error of the double 2 * pi.
+// d keeps its precision for |x| < 2^20.
+template <size_t N = SIN_TABLE_SIZE>
+void TableSinCos(double x, double& s, double& c)
+{
+	constexpr auto& t = sin_cos_table<N>;
+	constexpr double limit = 1 << 20;
+	constexpr double hi = bit_cast<double>(bit_cast<uint64_t>(t.step) & ~0xffff'ffffULL);
+	constexpr double mid = t.step - hi;
+	constexpr double lo = 2.4492935982947064e-16 / N;  // 2pi - 2 * numbers::pi
+	static_assert(limit / t.step < 0x1p32, "k hi must be exact");
+	if ( !(abs(x) < limit) )  return TableSinCosOutside(x, s, c);
+	const long long k = ConstRound(x * (1 / t.step));
+	const double d = ((x - k * hi) - k * mid) - k * lo;
+	const double d2 = d * d;
+	const double sd = d * (1 + d2 * (-1.0 / 6 + d2 * (1.0 / 120 - d2 / 5040)));
+	const double cd = 1 + d2 * (-0.5 + d2 * (1.0 / 24 + d2 * (-1.0 / 720 + d2 / 40320)));
+	const size_t i = static_cast<size_t>(k) & (N - 1);
+	s = t.sin[i] * cd + t.cos[i] * sd;
+	c = t.cos[i] * cd - t.sin[i] * sd;
+}
+
+template <size_t N = SIN_TABLE_SIZE>
+double TableSin(double x)
+{
+	double s, c;
+	TableSinCos<N>(x, s, c);
+	return s;
+}
+
+
+
+// 2^m for -1022 <= m <= 1023, built directly in the exponent bits
+inline double Pow2(long long m)
+{
+	return bit_cast<double>(static_cast<uint64_t>(m + 1023) << 52);
+}
+
+
+
+// |x| >= 708 or NaN, where 2^m alone may not be a normal number: it is
+// applied in two halves, so that a subnormal result is rounded only once.
+// Beyond the limits the result rounds to +inf or 0 (and k could overflow).
+template <size_t N>
+[[gnu::noinline, gnu::cold]] double TableExpOutside(double x)
+{
+	if ( x > 709.8 )  return HUGE_VAL;
+	if ( !(x > -745.2) )  return isnan(x) ? x : 0;
+	const long long k = ConstRound(x * (N / numbers::ln2));
+	const double r = x - k * (numbers::ln2 / N);
+	const double p = 1 + r * (1 + r * (0.5 + r * (1.0 / 6 + r * (1.0 / 24 + r / 120))));
+	const long long m = k >> countr_zero(N);
+	return exp2_table<N>[k & (N - 1)] * p * Pow2(m / 2) * Pow2(m - m / 2);
+}
+
+
+
+// x = (m N + i) ln2 / N + r, exp(x) = 2^m 2^(i/N) exp(r) with |r| <= ln2/(2N)
+template <size_t N = EXP_TABLE_SIZE>
+double TableExp(double x)
+{
+	static_assert((N & (N - 1)) == 0, "Table size must be a power of two");
+	if ( !(abs(x) < 708) )  return TableExpOutside<N>(x);
+	const long long k = ConstRound(x * (N / numbers::ln2));
+	const double r = x - k * (numbers::ln2 / N);
+	const double p = 1 + r * (1 + r * (0.5 + r * (1.0 / 6 + r * (1.0 / 24 + r / 120))));
+	return exp2_table<N>[k & (N - 1)] * p * Pow2(k >> countr_zero(N));
+}
+
+
+
+//-----------------------------------------------------------------------------
+
+
+template <size_t N>
+struct Polynomial  // c[0] + c[1] t + ... + c[N-1] t^(N-1)
+{
+	array<double, N> c {};
+	constexpr double operator()(double t) const
+	{
+		double r = c[N - 1];
+		for ( size_t i = N - 1; i-- > 0; )  r = r * t + c[i];  // Horner
+		return r;
+	}
+};
+
+
+
+// Chebyshev coefficients of f on [a, b] from its values at the Chebyshev nodes
+template <size_t N, typename F>
+constexpr array<double, N> ChebyshevCoefficients(F f, double a, double b)
+{
+	array<double, N> c {};
+	for ( size_t k = 0; k < N; ++k )
+	{
+		double sum = 0;
+		for ( size_t j = 0; j < N; ++j )
+		{
+			const double theta = numbers::pi * (j + 0.5) / N;
+			sum += f((a + b) / 2 + (b - a) / 2 * ConstCos(theta)) * ConstCos(k * theta);
+		}
+		c[k] = sum * (k == 0 ? 1.0 : 2.0) / N;
+	}
+	return c;
+}
+
+
+
+// The lowest degree whose dropped Chebyshev terms are below 'tol'
+template <typename F>
+constexpr size_t ChebyshevDegree(F f, double a, double b, double tol)
+{
+	constexpr size_t max_terms = 48;
+	const auto c = ChebyshevCoefficients<max_terms>(f, a, b);
+	double tail = 0;
+	size_t n = max_terms;
+	while ( n > 1 && tail + ConstAbs(c[n - 1]) < tol )  tail += ConstAbs(c[--n]);
+	return n - 1;
+}
+
+
+
+// Polynomial in t = (2x - a - b) / (b - a) equal to the truncated Chebyshev
+// series, so that evaluation is a single Horner loop.
+template <size_t Degree>
+struct ChebyshevApproximation
+{
+	Polynomial<Degree + 1> p;
+	double a;
+	double b;
+	constexpr double operator()(double x) const { return p((2 * x - a - b) / (b - a)); }
+};
+
+template <size_t Degree, typename F>
+constexpr ChebyshevApproximation<Degree> MakeChebyshevApproximation(F f, double a, double b)
+{
+	constexpr size_t n = Degree + 1;
+	const auto c = ChebyshevCoefficients<n>(f, a, b);
+	// Power coefficients of T(k): T(k+1) = 2t T(k) - T(k-1)
+	array<double, n> prev {}, cur {}, next {};
+	prev[0] = 1;  // T0
+	if ( n > 1 )  cur[1] = 1;  // T1
+	ChebyshevApproximation<Degree> result {{}, a, b};
+	result.p.c[0] = c[0];
+	if ( n > 1 )  result.p.c[1] = c[1];
+	for ( size_t k = 2; k < n; ++k )
+	{
+		for ( size_t i = 0; i < n; ++i )
+			next[i] = (i > 0 ? 2 * cur[i - 1] : 0) - prev[i];
+		for ( size_t i = 0; i < n; ++i )  result.p.c[i] += c[k] * next[i];
+		prev = cur;
+		cur = next;
+	}
+	return result;
+}
+
+
+
+// A damped oscillation, which costs two libm calls per value
+constexpr auto damped = [](double x) { return ConstExp(-x / 2) * ConstSin(x); };
+constexpr size_t damped_degree = ChebyshevDegree(damped, 0, 4, 1e-12);
+constexpr auto damped_approx = MakeChebyshevApproximation<damped_degree>(damped, 0, 4);
+
+// A fixed polynomial, e.g. 1 + 2x - 3x^2 + 0.5x^3, evaluated at compile time
+constexpr Polynomial<4> poly {{1, 2, -3, 0.5}};
+static_assert(poly(2) == 1 + 4 - 12 + 4);
+
+
+
+//-----------------------------------------------------------------------------
+
+
+template <typename F>
+double TimeMs(F f)
+{
+	const auto t = chrono::steady_clock::now();
+	f();
+	return chrono::duration<double, milli>(chrono::steady_clock::now() - t).count();
+}
+
+
+
+template <typename F1, typename F2>
+void Benchmark(const char* name, const vector<double>& x, F1 libm, F2 table)
+{
+	vector<double> r1(x.size()), r2(x.size());
+	const double t1 = TimeMs([&]{ for ( size_t i = 0; i < x.size(); ++i )  r1[i] = libm(x[i]); });
+	const double t2 = TimeMs([&]{ for ( size_t i = 0; i < x.size(); ++i )  r2[i] = table(x[i]); });
+	double err = 0;
+	for ( size_t i = 0; i < x.size(); ++i )
+		err = max(err, abs(r1[i] - r2[i]) / max(1.0, abs(r1[i])));
+	cout << setw(10) << left << name << right << " libm " << setw(5) << t1 * 1e6 / x.size()
+	     << " ns, table " << setw(5) << t2 * 1e6 / x.size() << " ns, max rel. error "
+	     << scientific << err << fixed << '\n';
+}
+
+
+
+int main()
+{
+	cout << setprecision(16);
+	cout << "pi^2/6 = " << zeta_2 << " (compile time), "
+	     << pow(acos(-1), 2) / 6 << " (run time)\n";
+	cout << "sin(0.8) = " << TableSin(0.8) << " (table), " << sin(0.8) << " (libm)\n";
+	cout << "sin(1e5) = " << TableSin(1e5) << " (table), " << sin(1e5) << " (libm)\n";
+	cout << "sin(1e300) = " << TableSin(1e300) << ", sin(NaN) = " << TableSin(NAN) << '\n';
+	cout << "exp(3)   = " << TableExp(3.0) << " (table), " << exp(3.0) << " (libm)\n";
+	cout << "Chebyshev approximation of exp(-x/2) sin(x) on [0, 4]: degree "
+	     << damped_degree << ", value at 1: " << damped_approx(1.0)
+	     << " (libm " << exp(-0.5) * sin(1.0) << ")\n";
+	cout << "Table sizes: sin/cos " << SIN_TABLE_SIZE << ", exp " << EXP_TABLE_SIZE
+	     << " (" << sizeof(sin_cos_table<SIN_TABLE_SIZE>) + sizeof(exp2_table<EXP_TABLE_SIZE>)
+	     << " bytes of read-only data)\n\n";
+
+	const size_t count = 10'000'000;
+	mt19937 gen(1);
+	vector<double> x(count);
+	cout << setprecision(2) << fixed;
+
+	uniform_real_distribution<double> d1(-10, 10);
+	for ( auto& v : x )  v = d1(gen);
+	Benchmark("sin", x, [](double v) { return sin(v); }, [](double v) { return TableSin(v); });
+	Benchmark("cos", x, [](double v) { return cos(v); },
+	          [](double v) { double s, c; TableSinCos(v, s, c); return c; });
+
+	uniform_real_distribution<double> d2(-30, 30);
+	for ( auto& v : x )  v = d2(gen);
+	Benchmark("exp", x, [](double v) { return exp(v); }, [](double v) { return TableExp(v); });
+
+	uniform_real_distribution<double> d3(0, 4);
+	for ( auto& v : x )  v = d3(gen);
+	Benchmark("damped", x, [](double v) { return exp(-v / 2) * sin(v); }, damped_approx);
+}
@@ -0,0 +1,362 @@
+/*****************************************************************************
+ * This model program demonstrates SomeClass of ctors_oper=.cpp with an
+ * optional copy-on-write payload: copies share one data array with an
+ * atomic reference count, and an object gets an array of its own only when
+ * it is written to while shared. Copies that are only read cost no
+ * allocation and no memcpy.
+ * g++ copy_on_write.cpp -std=c++20 -O2 -pthread -o copy_on_write
+ *****************************************************************************/
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <span>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+using Size = uint32_t;
+using Data = int;
+
+
+
+enum class Sharing { deep, cow };
+
+// The data array follows a reference count in one block, and p_data_ points
+// to the array, so that the element loops are the same as in
+// ctors_oper=.cpp. In the deep mode the count is always 1 and every copy
+// copies the array, as the original class does. In the cow mode copies
+// share the block, and the first write to a shared array detaches it:
+// DoSomething() overwrites every element, so it takes a new block without
+// copying the old one, and Set() copies it. Distinct objects sharing an
+// array may be used by different threads; one object may not, as with any
+// class.
+template <Sharing mode>
+class SomeClass
+{
+public:
+	SomeClass() = delete;
+	explicit SomeClass(Size size);
+	SomeClass(Size size, const string& name);
+	SomeClass(const SomeClass& other);
+	SomeClass(SomeClass&& other) noexcept;
+
+	~SomeClass() { Release(); }
+
+	const SomeClass& operator =(const SomeClass& other);
+	const SomeClass& operator =(SomeClass&& other) noexcept;
+
+	const SomeClass& DoSomething(Data value);
+	void Set(Size i, Data value);
+	span<const Data> Elements() const { return {p_data_, size_}; }
+	size_t UseCount() const { return p_data_ ? Block()->refs.load(memory_order_relaxed) : 0; }
+
+private:
+	struct BlockHeader  // Followed by the elements
+	{
+		atomic<size_t> refs;
+	};
+
+	Size size_ = 0;
+	Data* p_data_ = nullptr;
+	string name_ = "DefaultName";
+
+	BlockHeader* Block() const { return reinterpret_cast<BlockHeader*>(p_data_) - 1; }
+	static Data* Allocate(Size size);
+	void Share(const SomeClass& other);  // p_data_ is not owned
+	void Release();
+	void Detach(bool keep_data);
+
+	friend ostream& operator <<(ostream& out, const SomeClass& sc)
+	{
+		out << sc.name_ << ":";
+		if ( sc.size_ == 0 )  out << " empty";
+		for ( Size i = 0; i < sc.size_; ++i )  out << ' ' << sc.p_data_[i];
+		return out;
+	}
+};
+
+using DeepSomeClass = SomeClass<Sharing::deep>;
+using CowSomeClass = SomeClass<Sharing::cow>;
+
+
+
+template <Sharing mode>
+Data* SomeClass<mode>::Allocate(Size size)
+{
+	void* block = ::operator new(sizeof(BlockHeader) + sizeof(Data) * size);
+	return reinterpret_cast<Data*>(new (block) BlockHeader {1} + 1);
+}
+
+
+
+template <Sharing mode>
+void SomeClass<mode>::Share(const SomeClass& other)
+{
+	size_ = other.size_;
+	if constexpr ( mode == Sharing::cow )
+	{
+		p_data_ = other.p_data_;
+		if ( p_data_ )  Block()->refs.fetch_add(1, memory_order_relaxed);
+	}
+	else
+	{
+		p_data_ = other.p_data_ ? Allocate(size_) : nullptr;
+		if ( p_data_ )  memcpy(p_data_, other.p_data_, sizeof(Data) * size_);
+	}
+}
+
+
+
+// The last owner frees the block; acq_rel orders all the writes of the
+// other owners before it
+template <Sharing mode>
+void SomeClass<mode>::Release()
+{
+	if ( p_data_ && Block()->refs.fetch_sub(1, memory_order_acq_rel) == 1 )
+	{
+		Block()->~BlockHeader();
+		::operator delete(Block());
+	}
+	p_data_ = nullptr;
+}
+
+
+
+// A count of 1 cannot grow behind our back: only the owners copy the array
+template <Sharing mode>
+void SomeClass<mode>::Detach(bool keep_data)
+{
+	if ( mode == Sharing::deep || Block()->refs.load(memory_order_acquire) == 1 )  return;
+	Data* p = Allocate(size_);
+	if ( keep_data )  memcpy(p, p_data_, sizeof(Data) * size_);
+	Release();
+	p_data_ = p;
+}
+
+
+
+template <Sharing mode>
+SomeClass<mode>::SomeClass(Size size)
+	: size_ {size}, p_data_ {Allocate(size)}
+{
+}
+
+
+
+template <Sharing mode>
+SomeClass<mode>::SomeClass(Size size, const string& name)
+	: size_ {size}, p_data_ {Allocate(size)}, name_ {name}
+{
+}
+
+
+
+template <Sharing mode>
+SomeClass<mode>::SomeClass(const SomeClass& other)
+	: name_ {other.name_}
+{
+	Share(other);
+}
+
+
+
+template <Sharing mode>
+SomeClass<mode>::SomeClass(SomeClass&& other) noexcept
+	: size_ {other.size_}, p_data_ {other.p_data_}, name_ {move(other.name_)}
+{
+	other.size_ = 0;
+	other.p_data_ = nullptr;
+}
+
+
+
+// Assigning a copy of the same array is free in the cow mode, as in
+// sc2 = sc3 = sc4
+template <Sharing mode>
+const SomeClass<mode>& SomeClass<mode>::operator =(const SomeClass& other)
+{
+	if ( &other != this )
+	{
+		if ( mode == Sharing::deep || p_data_ != other.p_data_ )
+		{
+			Release();
+			Share(other);
+		}
+		name_ = other.name_;
+	}
+	return *this;
+}
+
+
+
+template <Sharing mode>
+const SomeClass<mode>& SomeClass<mode>::operator =(SomeClass&& other) noexcept
+{
+	if ( &other != this )
+	{
+		Release();
+		size_ = other.size_;
+		p_data_ = other.p_data_;
+		name_ = move(other.name_);
+		other.size_ = 0;
+		other.p_data_ = nullptr;
+	}
+	return *this;
+}
+
+
+
+template <Sharing mode>
+const SomeClass<mode>& SomeClass<mode>::DoSomething(Data value)
+{
+	if ( !p_data_ )  return *this;
+	Detach(false);
+	for ( Size i = 0; i < size_; ++i )  p_data_[i] = value;
+	return *this;
+}
+
+
+
+template <Sharing mode>
+void SomeClass<mode>::Set(Size i, Data value)
+{
+	Detach(true);
+	p_data_[i] = value;
+}
+
+
+
+//-----------------------------------------------------------------------------
+
+
+template <typename F>
+double TimeSec(F f)
+{
+	const auto t = chrono::steady_clock::now();
+	f();
+	return chrono::duration<double>(chrono::steady_clock::now() - t).count();
+}
+
+
+
+// The copies of main() in ctors_oper=.cpp, with the number of owners of
+// each array
+void Demo()
+{
+	CowSomeClass sc2(5);
+	sc2.DoSomething(1);
+	CowSomeClass sc3(9, "ObjectName");
+	sc3.DoSomething(2);
+	CowSomeClass sc4(sc3);
+	CowSomeClass sc5 = sc3;
+	CowSomeClass sc6 {sc3};
+	cout << "sc3..sc6 share: " << sc3.UseCount() << " owners\n";
+	sc6 = sc2;
+	cout << "sc6 = sc2: " << sc2.UseCount() << " and " << sc3.UseCount() << " owners\n";
+	sc2 = sc3 = sc4.DoSomething(3);
+	cout << "sc2 = sc3 = sc4.DoSomething(3): sc4 has " << sc4.UseCount() << " owners, sc5 "
+	     << sc5.UseCount() << ", sc6 " << sc6.UseCount() << '\n';
+	sc5.Set(0, 7);
+	cout << sc2 << '\n' << sc3 << '\n' << sc4 << '\n' << sc5 << '\n' << sc6 << "\n\n";
+}
+
+
+
+// Copies handed out and looked at, as values returned from a cache: each
+// operation copies an object and reads two of its elements
+template <typename T>
+double ReadMostly(const vector<T>& objects, size_t operations, int64_t& sum)
+{
+	return TimeSec([&]{
+		for ( size_t i = 0; i < operations; ++i )
+		{
+			const T copy(objects[(i * 7919) % objects.size()]);
+			const auto e = copy.Elements();
+			sum += e[i % e.size()] + e.back();
+		}
+	});
+}
+
+
+
+// The worst case of copy-on-write: every copy is written to at once
+template <typename T>
+double WriteAfterCopy(const vector<T>& objects, size_t operations)
+{
+	return TimeSec([&]{
+		for ( size_t i = 0; i < operations; ++i )
+		{
+			T copy(objects[(i * 7919) % objects.size()]);
+			copy.Set(0, static_cast<Data>(i));
+		}
+	});
+}
+
+
+
+// Read-mostly copies shared by several threads: all of them update the
+// same reference counts
+template <typename T>
+double SharedReads(const vector<T>& objects, size_t operations, size_t threads)
+{
+	return TimeSec([&]{
+		vector<thread> workers;
+		for ( size_t t = 0; t < threads; ++t )
+			workers.emplace_back([&]{
+				int64_t sum = 0;
+				ReadMostly(objects, operations / threads, sum);
+			});
+		for ( auto& w : workers )  w.join();
+	});
+}
+
+
+
+template <typename T>
+vector<T> Objects(Size size)
+{
+	vector<T> objects;
+	for ( int i = 0; i < 64; ++i )  objects.emplace_back(size).DoSomething(i);
+	return objects;
+}
+
+
+
+void Benchmark()
+{
+	const size_t operations = 2'000'000;
+	cout << "ns per copy:        read-mostly       write after copy    4 threads reading\n"
+	     << "   size            deep     cow          deep     cow          deep     cow\n";
+	for ( Size n : {4, 64, 1024, 16384} )
+	{
+		const auto deep = Objects<DeepSomeClass>(n);
+		const auto cow = Objects<CowSomeClass>(n);
+		const size_t ops = max<size_t>(100'000, operations / max<Size>(1, n / 64));
+		int64_t sums[2] = {};
+		const double sec[] = {
+			ReadMostly(deep, ops, sums[0]), ReadMostly(cow, ops, sums[1]),
+			WriteAfterCopy(deep, ops), WriteAfterCopy(cow, ops),
+			SharedReads(deep, ops, 4), SharedReads(cow, ops, 4) };
+		cout << setw(7) << n << "    ";
+		for ( size_t i = 0; i < size(sec); ++i )
+			cout << (i % 2 ? "" : "    ") << setw(8) << sec[i] * 1e9 / ops;
+		cout << (sums[0] == sums[1] ? "\n" : "   (sums differ)\n");
+	}
+}
+
+
+
+int main()
+{
+	Demo();
+	cout << fixed << setprecision(1);
+	Benchmark();
+}
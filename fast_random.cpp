@@ -0,0 +1,1533 @@
+/*****************************************************************************
+ * This model program demonstrates fast pseudo-random number engines
+ * (SplitMix64, xoshiro256** and PCG64) which satisfy the standard
+ * UniformRandomBitGenerator requirements and can fill a whole buffer in one
+ * call, compared with mt19937, minstd_rand and rand(); distributions and
+ * samplers built on them; histograms counted by several threads; and a
+ * thread-local replacement for rand().
+ * g++ fast_random.cpp -std=c++20 -O3 -march=native -pthread -o fast_random
+ *****************************************************************************/
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <stdlib.h>
+#include <time.h>
+#include <type_traits>
+#include <vector>
+
+using namespace std;
+
+
+
+// Weyl sequence plus a mixing function. The only dependency between values
+// is an addition, so the bulk version vectorizes. Mostly used to seed
+// other engines.
+class SplitMix64
+{
+public:
+	using result_type = uint64_t;
+
+	explicit SplitMix64(uint64_t seed = 0) : state_ {seed} {}
+	static constexpr result_type min() { return 0; }
+	static constexpr result_type max() { return UINT64_MAX; }
+	result_type operator()() { return Mix(state_ += gamma_); }
+
+	void Generate(span<uint64_t> out)  // The same values as calling operator()
+	{
+		uint64_t x = state_;
+		for ( size_t i = 0; i < out.size(); ++i )
+		{
+			x += gamma_;
+			out[i] = Mix(x);
+		}
+		state_ = x;
+	}
+
+private:
+	uint64_t state_;
+	static constexpr uint64_t gamma_ = 0x9e3779b97f4a7c15;
+
+	static uint64_t Mix(uint64_t z)
+	{
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+		return z ^ (z >> 31);
+	}
+};
+
+
+
+// xoshiro256** by Blackman and Vigna: 32 bytes of state, period 2^256 - 1.
+class Xoshiro256StarStar
+{
+public:
+	using result_type = uint64_t;
+	static constexpr size_t lanes = 8;  // Independent streams of Generate()
+
+	explicit Xoshiro256StarStar(uint64_t seed = 0);
+	static constexpr result_type min() { return 0; }
+	static constexpr result_type max() { return UINT64_MAX; }
+	result_type operator()() { return Next(s_[0], s_[1], s_[2], s_[3]); }
+
+	void Jump();      // Equivalent to 2^128 calls of operator()
+	void LongJump();  // Equivalent to 2^192 calls, for streams that use Generate()
+	void Generate(span<uint64_t> out);
+
+private:
+	// GCC/Clang vector extension: one state word of every lane in a single
+	// vector. Plain arrays of lanes end up in scalar registers with GCC.
+	using Lanes = uint64_t __attribute__((vector_size(lanes * sizeof(uint64_t))));
+
+	array<uint64_t, 4> s_;
+	array<Lanes, 4> lane_s_ {};
+	bool lanes_ready_ = false;
+
+	void Jump(const array<uint64_t, 4>& polynomial);
+
+	static uint64_t Next(uint64_t& s0, uint64_t& s1, uint64_t& s2, uint64_t& s3)
+	{
+		const uint64_t result = rotl(s1 * 5, 7) * 9;
+		const uint64_t t = s1 << 17;
+		s2 ^= s0;
+		s3 ^= s1;
+		s1 ^= s2;
+		s0 ^= s3;
+		s2 ^= t;
+		s3 = rotl(s3, 45);
+		return result;
+	}
+};
+
+
+
+Xoshiro256StarStar::Xoshiro256StarStar(uint64_t seed)
+{
+	SplitMix64 sm(seed);  // Never gives the all-zero state
+	for ( auto& s : s_ )  s = sm();
+}
+
+
+
+void Xoshiro256StarStar::Jump()
+{
+	Jump({0x180ec6d33cfd0aba, 0xd5a61266f0c9392c, 0xa9582618e03fc9aa, 0x39abdc4529b1661c});
+}
+
+
+
+void Xoshiro256StarStar::LongJump()
+{
+	Jump({0x76e15d3efefdcbbf, 0xc5004e441c522fb3, 0x77710069854ee241, 0x39109bb02acbe635});
+}
+
+
+
+void Xoshiro256StarStar::Jump(const array<uint64_t, 4>& polynomial)
+{
+	array<uint64_t, 4> t {};
+	for ( uint64_t j : polynomial )
+		for ( int b = 0; b < 64; ++b )
+		{
+			if ( j & (uint64_t {1} << b) )
+				for ( int w = 0; w < 4; ++w )  t[w] ^= s_[w];
+			(*this)();
+		}
+	s_ = t;
+}
+
+
+
+// The buffer is filled by 'lanes' interleaved generators, each 2^128 values
+// apart, so one step of all of them is a few vector instructions.
+// The sequence therefore differs from repeated operator() calls. On first
+// use the lanes are split off the scalar state, which then jumps past them.
+void Xoshiro256StarStar::Generate(span<uint64_t> out)
+{
+	if ( !lanes_ready_ )
+	{
+		for ( size_t l = 0; l < lanes; ++l )
+		{
+			for ( int w = 0; w < 4; ++w )  lane_s_[w][l] = s_[w];
+			Jump();
+		}
+		lanes_ready_ = true;
+	}
+	auto [s0, s1, s2, s3] = lane_s_;
+	size_t i = 0;
+	for ( ; i + lanes <= out.size(); i += lanes )
+	{
+		const Lanes x = s1 * 5;
+		const Lanes r = ((x << 7) | (x >> 57)) * 9;
+		memcpy(&out[i], &r, sizeof(r));
+		const Lanes t = s1 << 17;
+		s2 ^= s0;
+		s3 ^= s1;
+		s1 ^= s2;
+		s0 ^= s3;
+		s2 ^= t;
+		s3 = (s3 << 45) | (s3 >> 19);
+	}
+	lane_s_ = {s0, s1, s2, s3};
+	for ( ; i < out.size(); ++i )  out[i] = (*this)();  // Tail from the scalar stream
+}
+
+
+
+// PCG64 (XSL-RR 128/64) by O'Neill: a 128-bit LCG with a permuted output.
+// The 128-bit multiply has no vector form, so the bulk version is a loop.
+class Pcg64
+{
+public:
+	using result_type = uint64_t;
+
+	explicit Pcg64(uint64_t seed = 0, uint64_t stream = 0);
+	static constexpr result_type min() { return 0; }
+	static constexpr result_type max() { return UINT64_MAX; }
+	result_type operator()()
+	{
+		state_ = state_ * multiplier_ + increment_;
+		const uint64_t x = static_cast<uint64_t>(state_ >> 64) ^ static_cast<uint64_t>(state_);
+		return rotr(x, static_cast<int>(state_ >> 122));
+	}
+
+	void Generate(span<uint64_t> out)
+	{
+		for ( auto& v : out )  v = (*this)();
+	}
+
+private:
+	using uint128 = unsigned __int128;  // GCC and Clang extension
+	uint128 state_ = 0;
+	uint128 increment_;
+	static constexpr uint128 multiplier_ =
+		(uint128 {0x2360ed051fc65da4} << 64) | 0x4385df649fccf645;
+};
+
+
+
+Pcg64::Pcg64(uint64_t seed, uint64_t stream)
+	: increment_ {(uint128 {stream} << 1) | 1}  // Must be odd
+{
+	(*this)();
+	state_ += seed;
+	(*this)();
+}
+
+
+
+static_assert(uniform_random_bit_generator<SplitMix64>);
+static_assert(uniform_random_bit_generator<Xoshiro256StarStar>);
+static_assert(uniform_random_bit_generator<Pcg64>);
+
+
+//-----------------------------------------------------------------------------
+
+
+// Distributions below are defined only in terms of the 64-bit output of the
+// engine, so a seed gives the same values with any standard library (the
+// algorithms of std:: distributions are implementation-defined).
+
+template <typename Engine>
+concept BulkEngine = requires(Engine e, span<uint64_t> s) { e.Generate(s); };
+
+// Engines whose every value has 64 random bits, such as the three above and
+// mt19937_64. A 32-bit engine such as mt19937 would leave the high words of
+// the multiply-shift products below always zero.
+template <typename Engine>
+concept FullEngine = uniform_random_bit_generator<Engine> &&
+                     Engine::min() == 0 && Engine::max() == UINT64_MAX;
+
+template <FullEngine Engine>
+void FillRaw(Engine& engine, span<uint64_t> out)
+{
+	if constexpr ( BulkEngine<Engine> )  engine.Generate(out);
+	else  for ( auto& v : out )  v = engine();
+}
+
+
+
+// Integers on [a, b] by Lemire's multiply-shift method. x * range is a
+// 128-bit product; its high word is the result and its low word tells how
+// x fell within that result's bucket. Rejecting the low words below
+// 2^64 mod range leaves exactly floor(2^64 / range) values of x for each
+// result, so the output is exactly uniform. Rejection happens with
+// probability below range / 2^64, and there is no division per value.
+template <typename T>
+class UniformInt
+{
+public:
+	UniformInt(T a, T b);
+
+	template <FullEngine Engine> T operator()(Engine& engine) const;
+	template <FullEngine Engine> void Fill(Engine& engine, span<T> out) const;
+
+private:
+	T a_;
+	uint64_t range_;      // b - a + 1, zero for the full 64-bit range
+	uint64_t threshold_;  // 2^64 mod range
+	uint32_t threshold32_ = 0;  // 2^32 mod range, for the batch path
+};
+
+
+
+template <typename T>
+UniformInt<T>::UniformInt(T a, T b)
+	: a_ {a}, range_ {static_cast<uint64_t>(b) - static_cast<uint64_t>(a) + 1}
+{
+	static_assert(is_integral_v<T> && sizeof(T) <= sizeof(uint64_t));
+	if ( b < a )  throw invalid_argument("UniformInt: b < a");
+	threshold_ = (range_ == 0) ? 0 : (0 - range_) % range_;
+	if ( range_ != 0 && range_ <= (uint64_t {1} << 32) )
+		threshold32_ = static_cast<uint32_t>((uint64_t {1} << 32) % range_);
+}
+
+
+
+template <typename T>
+template <FullEngine Engine>
+inline T UniformInt<T>::operator()(Engine& engine) const  // GCC needs the hint to inline it
+{
+	if ( range_ == 0 )  return static_cast<T>(engine());
+	unsigned __int128 m = static_cast<unsigned __int128>(engine()) * range_;
+	while ( static_cast<uint64_t>(m) < threshold_ )  // Rare
+		m = static_cast<unsigned __int128>(engine()) * range_;
+	return static_cast<T>(static_cast<uint64_t>(a_) + static_cast<uint64_t>(m >> 64));
+}
+
+
+
+// For ranges up to 2^32 every 64-bit value gives two 32-bit ones, and the
+// 32 x 32 -> 64-bit multiply-shift vectorizes. Rejected positions are
+// redrawn by the scalar method in a second pass, which is only entered
+// when a block has any.
+template <typename T>
+template <FullEngine Engine>
+void UniformInt<T>::Fill(Engine& engine, span<T> out) const
+{
+	if ( range_ == 0 || range_ > (uint64_t {1} << 32) )
+	{
+		for ( auto& v : out )  v = (*this)(engine);
+		return;
+	}
+	constexpr size_t block = 1024;
+	uint64_t raw[block];
+	uint32_t x[2 * block];
+	const uint64_t a = static_cast<uint64_t>(a_);
+	for ( size_t pos = 0; pos < out.size(); pos += 2 * block )
+	{
+		const size_t count = min(2 * block, out.size() - pos);
+		FillRaw(engine, span(raw, (count + 1) / 2));
+		memcpy(x, raw, count * sizeof(uint32_t));
+		T* dst = &out[pos];
+		size_t rejected = 0;
+		for ( size_t i = 0; i < count; ++i )
+		{
+			const uint64_t m = uint64_t {x[i]} * range_;
+			dst[i] = static_cast<T>(a + (m >> 32));
+			rejected += static_cast<uint32_t>(m) < threshold32_;
+		}
+		if ( rejected )
+			for ( size_t i = 0; i < count; ++i )
+				if ( static_cast<uint32_t>(uint64_t {x[i]} * range_) < threshold32_ )
+					dst[i] = (*this)(engine);
+	}
+}
+
+
+
+// Reals on [a, b) from the mantissa bits: the top bits of a random value
+// below the exponent of 1.0 give a number in [1, 2), minus one gives [0, 1)
+// with 52 (double) or 23 (float) random bits. No integer-to-float
+// conversion is needed, so the batch loop vectorizes on any SIMD target.
+template <typename T>
+class UniformReal
+{
+public:
+	UniformReal(T a, T b);
+
+	template <FullEngine Engine> T operator()(Engine& engine) const { return Map(engine()); }
+	template <FullEngine Engine> void Fill(Engine& engine, span<T> out) const;
+
+private:
+	T a_;
+	T scale_;
+	T below_b_;  // a + scale * u may round up to b
+
+	T Map(uint64_t x) const
+	{
+		T u;
+		if constexpr ( is_same_v<T, float> )
+			u = bit_cast<float>(static_cast<uint32_t>(x >> 41) | 0x3f800000u) - 1.0f;
+		else
+			u = bit_cast<double>((x >> 12) | 0x3ff0000000000000u) - 1.0;
+		return min(a_ + scale_ * u, below_b_);
+	}
+};
+
+
+
+template <typename T>
+UniformReal<T>::UniformReal(T a, T b)
+	: a_ {a}, scale_ {b - a}, below_b_ {nextafter(b, a)}
+{
+	static_assert(is_same_v<T, float> || is_same_v<T, double>);
+	if ( !(a < b) )  throw invalid_argument("UniformReal: empty interval");
+}
+
+
+
+template <typename T>
+template <FullEngine Engine>
+void UniformReal<T>::Fill(Engine& engine, span<T> out) const
+{
+	constexpr size_t block = 1024;
+	uint64_t raw[block];
+	for ( size_t pos = 0; pos < out.size(); pos += block )
+	{
+		const size_t count = min(block, out.size() - pos);
+		FillRaw(engine, span(raw, count));
+		T* dst = &out[pos];
+		for ( size_t i = 0; i < count; ++i )  dst[i] = Map(raw[i]);
+	}
+}
+
+//-----------------------------------------------------------------------------
+
+
+// Walker's alias method with Vose's O(n) construction. Every column holds
+// its own outcome with probability prob_[i] and the alias outcome otherwise,
+// so a sample is one random value, one multiply and one comparison.
+class AliasTable
+{
+public:
+	explicit AliasTable(span<const double> weights);
+
+	size_t size() const { return columns_.size(); }
+	template <FullEngine Engine> uint32_t operator()(Engine& engine) const;
+	template <FullEngine Engine> void Fill(Engine& engine, span<uint32_t> out) const;
+
+private:
+	// Probability to keep the column, scaled to 2^32, in the low word and the
+	// alias in the high word: one load, and 64-bit lanes like those of x
+	vector<uint64_t> columns_;
+
+	static uint64_t Column(double prob, uint32_t alias)
+	{
+		return static_cast<uint64_t>(min(prob * 4294967296.0, 4294967295.0))
+		       | uint64_t {alias} << 32;
+	}
+
+	// t is x * n >> 32 for a 64-bit x, computed as (x_hi * n) + (x_lo * n >> 32)
+	// without a 128-bit product, so that the batch loop vectorizes. Its high
+	// word is the column, and its low word, the top 32 bits of the position of
+	// x within the column, is the coin; both are exact for any n <= 2^32.
+	static uint32_t Select(uint64_t x, uint64_t n, const uint64_t* columns)
+	{
+		const uint64_t t = (x >> 32) * n + (((x & 0xffffffff) * n) >> 32);
+		const uint64_t column = t >> 32;
+		const uint64_t c = columns[column];
+		const uint64_t alias = c >> 32;
+		// A mask instead of ?:, which GCC turns into an unpredictable branch
+		const uint64_t keep = -static_cast<uint64_t>((t & 0xffffffff) < (c & 0xffffffff));
+		return static_cast<uint32_t>(alias ^ ((alias ^ column) & keep));
+	}
+};
+
+
+
+AliasTable::AliasTable(span<const double> weights)
+	: columns_(weights.size())
+{
+	const size_t n = weights.size();
+	if ( n == 0 || n > UINT32_MAX )  throw invalid_argument("AliasTable: bad number of weights");
+	double sum = 0;
+	for ( double w : weights )
+	{
+		if ( !(w >= 0) )  throw invalid_argument("AliasTable: negative weight");
+		sum += w;
+	}
+	if ( !(sum > 0) )  throw invalid_argument("AliasTable: all weights are zero");
+
+	vector<double> scaled(n);  // Mean 1
+	vector<uint32_t> small, large;
+	for ( size_t i = 0; i < n; ++i )
+	{
+		scaled[i] = weights[i] * n / sum;
+		(scaled[i] < 1 ? small : large).push_back(static_cast<uint32_t>(i));
+	}
+	while ( !small.empty() && !large.empty() )
+	{
+		const uint32_t s = small.back(), l = large.back();
+		small.pop_back();
+		columns_[s] = Column(scaled[s], l);
+		scaled[l] -= 1 - scaled[s];  // The large one fills the rest of column s
+		if ( scaled[l] < 1 )
+		{
+			large.pop_back();
+			small.push_back(l);
+		}
+	}
+	for ( uint32_t i : large )  columns_[i] = Column(1, i);
+	for ( uint32_t i : small )  columns_[i] = Column(1, i);  // Rounding leftovers
+}
+
+
+
+// The integer part of x * n / 2^64 picks the column, the fraction is
+// uniform within the column and decides between the column and its alias.
+template <FullEngine Engine>
+inline uint32_t AliasTable::operator()(Engine& engine) const
+{
+	return Select(engine(), size(), columns_.data());
+}
+
+
+
+// The same computation on a block of values. The table reads become vector
+// gathers.
+template <FullEngine Engine>
+void AliasTable::Fill(Engine& engine, span<uint32_t> out) const
+{
+	constexpr size_t block = 1024;
+	uint64_t raw[block];
+	const uint64_t n = size();
+	const uint64_t* columns = columns_.data();
+	for ( size_t pos = 0; pos < out.size(); pos += block )
+	{
+		const size_t count = min(block, out.size() - pos);
+		FillRaw(engine, span(raw, count));
+		uint32_t* dst = &out[pos];
+		for ( size_t i = 0; i < count; ++i )  dst[i] = Select(raw[i], n, columns);
+	}
+}
+
+
+
+// Ziggurat of 256 layers of equal area under an unnormalized density f
+// (Marsaglia and Tsang). Layer i is the rectangle [0, x[i]] x [f(x[i]),
+// f(x[i+1])]; layer 0 also covers the tail beyond r = x[1] and so has the
+// virtual width v / f(r). A sample is uniform within a random layer and is
+// accepted at once when it lies under the next layer (about 99% of cases).
+struct ZigguratLayers
+{
+	static constexpr size_t count = 256;
+	array<double, count + 1> x;
+	array<double, count + 1> f;
+
+	ZigguratLayers(double r, double v, double (*pdf)(double), double (*pdf_inverse)(double))
+	{
+		x[0] = v / pdf(r);
+		x[1] = r;
+		for ( size_t i = 1; i < count - 1; ++i )  x[i + 1] = pdf_inverse(v / x[i] + pdf(x[i]));
+		x[count] = 0;
+		for ( size_t i = 0; i <= count; ++i )  f[i] = pdf(x[i]);
+	}
+};
+
+
+
+// One 64-bit value gives the layer (bits 0-7), the sign (bit 8) and a
+// uniform number from the mantissa bits (12-63).
+struct ZigguratDraw
+{
+	size_t layer;
+	uint64_t sign;  // As the sign bit of a double
+	double u;       // [0, 1)
+
+	explicit ZigguratDraw(uint64_t r)
+		: layer {r & 0xff}, sign {(r & 0x100) << 55},
+		  u {bit_cast<double>((r >> 12) | 0x3ff0000000000000u) - 1.0} {}
+};
+
+
+
+class NormalZiggurat
+{
+public:
+	NormalZiggurat(double mean = 0, double stddev = 1) : mean_ {mean}, stddev_ {stddev} {}
+
+	template <FullEngine Engine> double operator()(Engine& engine) const
+	{
+		const ZigguratDraw d(engine());
+		const double* x = Layers().x.data();
+		const double v = d.u * x[d.layer];
+		if ( v < x[d.layer + 1] )  return mean_ + stddev_ * bit_cast<double>(bit_cast<uint64_t>(v) | d.sign);
+		return mean_ + stddev_ * Sample(engine, d);
+	}
+	template <FullEngine Engine> void Fill(Engine& engine, span<double> out) const;
+
+private:
+	double mean_;
+	double stddev_;
+
+	static const ZigguratLayers& Layers()
+	{
+		static const ZigguratLayers layers(3.6541528853610088, 0.00492867323399,
+			[](double x) { return exp(-x * x / 2); },
+			[](double y) { return sqrt(-2 * log(y)); });
+		return layers;
+	}
+	template <FullEngine Engine> static double Sample(Engine& engine, ZigguratDraw d);
+};
+
+
+
+// Completes the draw d, drawing again only if it is finally rejected. Fill
+// calls it for the samples its fast path has left, so that every sample
+// goes through exactly the same steps as in the scalar algorithm.
+template <FullEngine Engine>
+double NormalZiggurat::Sample(Engine& engine, ZigguratDraw d)
+{
+	const ZigguratLayers& z = Layers();
+	const double r = z.x[1];
+	UniformReal<double> uniform(0, 1);
+	for ( ;; d = ZigguratDraw(engine()) )
+	{
+		const double x = d.u * z.x[d.layer];
+		const double signed_x = bit_cast<double>(bit_cast<uint64_t>(x) | d.sign);
+		if ( x < z.x[d.layer + 1] )  return signed_x;
+		if ( d.layer == 0 )  // The tail beyond r, by Marsaglia's method
+		{
+			double a, b;
+			do
+			{
+				a = -log1p(-uniform(engine)) / r;
+				b = -log1p(-uniform(engine));
+			} while ( b + b < a * a );
+			return d.sign ? -(r + a) : r + a;
+		}
+		// The wedge between the layer rectangle and the curve
+		const double y = z.f[d.layer] + uniform(engine) * (z.f[d.layer + 1] - z.f[d.layer]);
+		if ( y < exp(-x * x / 2) )  return signed_x;
+	}
+}
+
+
+
+// The common case is computed for the whole block in one vectorizable loop
+// (with gathers for the layer widths); the few samples that fall outside
+// the inner rectangles are finished by the scalar algorithm afterwards.
+template <FullEngine Engine>
+void NormalZiggurat::Fill(Engine& engine, span<double> out) const
+{
+	const double* x = Layers().x.data();
+	constexpr size_t block = 1024;
+	uint64_t raw[block];
+	for ( size_t pos = 0; pos < out.size(); pos += block )
+	{
+		const size_t count = min(block, out.size() - pos);
+		FillRaw(engine, span(raw, count));
+		double* dst = &out[pos];
+		size_t rejected = 0;
+		for ( size_t i = 0; i < count; ++i )
+		{
+			const ZigguratDraw d(raw[i]);
+			const double v = d.u * x[d.layer];
+			dst[i] = mean_ + stddev_ * bit_cast<double>(bit_cast<uint64_t>(v) | d.sign);
+			rejected += !(v < x[d.layer + 1]);
+		}
+		if ( rejected )
+			for ( size_t i = 0; i < count; ++i )
+			{
+				const ZigguratDraw d(raw[i]);
+				if ( !(d.u * x[d.layer] < x[d.layer + 1]) )  dst[i] = mean_ + stddev_ * Sample(engine, d);
+			}
+	}
+}
+
+
+
+class ExponentialZiggurat
+{
+public:
+	explicit ExponentialZiggurat(double lambda = 1) : inv_lambda_ {1 / lambda} {}
+
+	template <FullEngine Engine> double operator()(Engine& engine) const
+	{
+		const ZigguratDraw d(engine());
+		const double* x = Layers().x.data();
+		const double v = d.u * x[d.layer];
+		return inv_lambda_ * (v < x[d.layer + 1] ? v : Sample(engine, d));
+	}
+	template <FullEngine Engine> void Fill(Engine& engine, span<double> out) const;
+
+private:
+	double inv_lambda_;
+
+	static const ZigguratLayers& Layers()
+	{
+		static const ZigguratLayers layers(7.69711747013104972, 0.0039496598225815571993,
+			[](double x) { return exp(-x); },
+			[](double y) { return -log(y); });
+		return layers;
+	}
+	template <FullEngine Engine> static double Sample(Engine& engine, ZigguratDraw d);
+};
+
+
+
+template <FullEngine Engine>
+double ExponentialZiggurat::Sample(Engine& engine, ZigguratDraw d)  // The sign bit is not used
+{
+	const ZigguratLayers& z = Layers();
+	UniformReal<double> uniform(0, 1);
+	for ( ;; d = ZigguratDraw(engine()) )
+	{
+		const double x = d.u * z.x[d.layer];
+		if ( x < z.x[d.layer + 1] )  return x;
+		if ( d.layer == 0 )  return z.x[1] - log1p(-uniform(engine));  // Memoryless tail
+		const double y = z.f[d.layer] + uniform(engine) * (z.f[d.layer + 1] - z.f[d.layer]);
+		if ( y < exp(-x) )  return x;
+	}
+}
+
+
+
+template <FullEngine Engine>
+void ExponentialZiggurat::Fill(Engine& engine, span<double> out) const
+{
+	const double* x = Layers().x.data();
+	constexpr size_t block = 1024;
+	uint64_t raw[block];
+	for ( size_t pos = 0; pos < out.size(); pos += block )
+	{
+		const size_t count = min(block, out.size() - pos);
+		FillRaw(engine, span(raw, count));
+		double* dst = &out[pos];
+		size_t rejected = 0;
+		for ( size_t i = 0; i < count; ++i )
+		{
+			const ZigguratDraw d(raw[i]);
+			const double v = d.u * x[d.layer];
+			dst[i] = inv_lambda_ * v;
+			rejected += !(v < x[d.layer + 1]);
+		}
+		if ( rejected )
+			for ( size_t i = 0; i < count; ++i )
+			{
+				const ZigguratDraw d(raw[i]);
+				if ( !(d.u * x[d.layer] < x[d.layer + 1]) )  dst[i] = inv_lambda_ * Sample(engine, d);
+			}
+	}
+}
+
+
+
+//-----------------------------------------------------------------------------
+
+
+// Dense counters for slots 0..n-1. A block of slots is counted into 4 copies
+// of the counters in turn, so equal neighbouring values increment different
+// memory and the increments do not wait for each other. The copies are
+// summed when a count is read.
+class BinCounts
+{
+public:
+	explicit BinCounts(size_t slots) : slots_ {slots}, counts_(copies * slots) {}
+
+	size_t Slots() const { return slots_; }
+	uint64_t operator [](size_t slot) const;
+	void Add(uint32_t slot) { ++counts_[slot]; }
+	void Add(span<const uint32_t> slots);
+	BinCounts& operator +=(const BinCounts& other);
+
+private:
+	static constexpr size_t copies = 4;
+	size_t slots_;
+	vector<uint64_t> counts_;  // Copy c of slot s is counts_[c * slots_ + s]
+};
+
+
+
+uint64_t BinCounts::operator [](size_t slot) const
+{
+	uint64_t sum = 0;
+	for ( size_t c = 0; c < copies; ++c )  sum += counts_[c * slots_ + slot];
+	return sum;
+}
+
+
+
+void BinCounts::Add(span<const uint32_t> slots)
+{
+	uint64_t* c0 = counts_.data();
+	uint64_t* c1 = c0 + slots_;
+	uint64_t* c2 = c1 + slots_;
+	uint64_t* c3 = c2 + slots_;
+	size_t i = 0;
+	for ( ; i + copies <= slots.size(); i += copies )
+	{
+		++c0[slots[i]];
+		++c1[slots[i + 1]];
+		++c2[slots[i + 2]];
+		++c3[slots[i + 3]];
+	}
+	for ( ; i < slots.size(); ++i )  ++c0[slots[i]];
+}
+
+
+
+BinCounts& BinCounts::operator +=(const BinCounts& other)
+{
+	if ( other.slots_ != slots_ )  throw invalid_argument("BinCounts: different number of bins");
+	for ( size_t i = 0; i < counts_.size(); ++i )  counts_[i] += other.counts_[i];
+	return *this;
+}
+
+
+
+// Bins for every integer of [min, max]. Slot 0 counts values below min and
+// the last slot values above max.
+template <typename T>
+class IntHistogram
+{
+public:
+	using value_type = T;
+
+	IntHistogram(T min, T max);
+
+	size_t Bins() const { return counts_.Slots() - 2; }
+	uint64_t operator [](T value) const { return counts_[Slot(value, min_, max_, Bins() + 1)]; }
+	uint64_t Underflow() const { return counts_[0]; }
+	uint64_t Overflow() const { return counts_[Bins() + 1]; }
+	void Add(T value) { counts_.Add(Slot(value, min_, max_, Bins() + 1)); }
+	void Add(span<const T> values);
+	IntHistogram& operator +=(const IntHistogram& other);
+	void Print(ostream& os, uint64_t per_star) const;
+
+private:
+	T min_;
+	T max_;
+	BinCounts counts_;
+
+	static size_t CheckedBins(T min, T max);
+
+	// Selects only and no member reads, so that a loop of it vectorizes
+	static uint32_t Slot(T value, T min, T max, uint32_t overflow)
+	{
+		// Unsigned, since value - min overflows T when value is far out of range;
+		// int8_t and int16_t are promoted to int, so the difference is cast back
+		using U = make_unsigned_t<T>;
+		const U offset = static_cast<U>(static_cast<U>(value) - static_cast<U>(min));
+		const uint32_t inside = static_cast<uint32_t>(offset) + 1;
+		return value < min ? 0 : (value > max ? overflow : inside);
+	}
+};
+
+
+
+template <typename T>
+IntHistogram<T>::IntHistogram(T min, T max)
+	: min_ {min}, max_ {max}, counts_(CheckedBins(min, max) + 2)
+{
+}
+
+
+
+template <typename T>
+size_t IntHistogram<T>::CheckedBins(T min, T max)
+{
+	static_assert(is_integral_v<T>);
+	if ( !(min <= max) )  throw invalid_argument("IntHistogram: empty range");
+	const uint64_t bins = static_cast<uint64_t>(max) - static_cast<uint64_t>(min) + 1;
+	if ( bins == 0 || bins > (1u << 28) )
+		throw invalid_argument("IntHistogram: range is too wide for dense bins");
+	return bins;
+}
+
+
+
+// Slots are computed for a block at a time in a vectorizable loop, then counted.
+template <typename T>
+void IntHistogram<T>::Add(span<const T> values)
+{
+	constexpr size_t block = 1024;
+	uint32_t slots[block];
+	const T lo = min_, hi = max_;
+	const uint32_t overflow = static_cast<uint32_t>(Bins() + 1);
+	for ( size_t pos = 0; pos < values.size(); pos += block )
+	{
+		const size_t count = min(block, values.size() - pos);
+		for ( size_t i = 0; i < count; ++i )  slots[i] = Slot(values[pos + i], lo, hi, overflow);
+		counts_.Add(span(slots, count));
+	}
+}
+
+
+
+template <typename T>
+IntHistogram<T>& IntHistogram<T>::operator +=(const IntHistogram& other)
+{
+	if ( other.min_ != min_ || other.max_ != max_ )  throw invalid_argument("IntHistogram: different ranges");
+	counts_ += other.counts_;
+	return *this;
+}
+
+
+
+// The same bar chart as in random_numbers.cpp
+template <typename T>
+void IntHistogram<T>::Print(ostream& os, uint64_t per_star) const
+{
+	for ( size_t b = 0; b < Bins(); ++b )
+		os << +static_cast<T>(min_ + b) << " : " << string(counts_[b + 1] / per_star, '*') << '\n';
+}
+
+
+
+// 'bins' bins of equal width on [low, high). Slot 0 counts values below low
+// and NaNs, the last slot values from high up.
+template <typename T>
+class RealHistogram
+{
+public:
+	using value_type = T;
+
+	RealHistogram(T low, T high, size_t bins);
+
+	size_t Bins() const { return counts_.Slots() - 2; }
+	uint64_t Bin(size_t b) const { return counts_[b + 1]; }
+	T BinLow(size_t b) const { return low_ + b * width_; }
+	uint64_t Underflow() const { return counts_[0]; }
+	uint64_t Overflow() const { return counts_[Bins() + 1]; }
+	void Add(T value) { counts_.Add(Slot(value, Params())); }
+	void Add(span<const T> values);
+	RealHistogram& operator +=(const RealHistogram& other);
+	void Print(ostream& os, uint64_t per_star) const;
+
+private:
+	T low_;
+	T high_;
+	T width_;
+	T inv_width_;
+	BinCounts counts_;
+
+	struct SlotParams
+	{
+		T low, high, inv_width, last_bin;
+		uint32_t overflow;
+	};
+	SlotParams Params() const
+	{
+		return {low_, high_, inv_width_, static_cast<T>(Bins() - 1), static_cast<uint32_t>(Bins() + 1)};
+	}
+	static uint32_t Slot(T value, const SlotParams& p)
+	{
+		// Only values in range are converted: NaN or a huge value would not fit
+		const bool in_range = value >= p.low && value < p.high;
+		const T t = in_range ? min((value - p.low) * p.inv_width, p.last_bin) : T {0};  // May round up
+		const uint32_t inside = static_cast<uint32_t>(t) + 1;
+		return !(value >= p.low) ? 0 : (in_range ? inside : p.overflow);
+	}
+};
+
+
+
+template <typename T>
+RealHistogram<T>::RealHistogram(T low, T high, size_t bins)
+	: low_ {low}, high_ {high}, width_ {(high - low) / bins}, inv_width_ {bins / (high - low)},
+	  counts_(bins + 2)
+{
+	static_assert(is_floating_point_v<T>);
+	if ( !(low < high) )  throw invalid_argument("RealHistogram: empty interval");
+	if ( bins == 0 || bins > (1u << 28) )  throw invalid_argument("RealHistogram: bad number of bins");
+}
+
+
+
+template <typename T>
+void RealHistogram<T>::Add(span<const T> values)
+{
+	constexpr size_t block = 1024;
+	uint32_t slots[block];
+	const SlotParams p = Params();
+	for ( size_t pos = 0; pos < values.size(); pos += block )
+	{
+		const size_t count = min(block, values.size() - pos);
+		for ( size_t i = 0; i < count; ++i )  slots[i] = Slot(values[pos + i], p);
+		counts_.Add(span(slots, count));
+	}
+}
+
+
+
+template <typename T>
+RealHistogram<T>& RealHistogram<T>::operator +=(const RealHistogram& other)
+{
+	if ( other.low_ != low_ || other.high_ != high_ )
+		throw invalid_argument("RealHistogram: different intervals");
+	counts_ += other.counts_;
+	return *this;
+}
+
+
+
+template <typename T>
+void RealHistogram<T>::Print(ostream& os, uint64_t per_star) const
+{
+	for ( size_t b = 0; b < Bins(); ++b )
+		os << setw(8) << BinLow(b) << " : " << string(Bin(b) / per_star, '*') << '\n';
+}
+
+
+
+// Every thread samples from its own xoshiro stream (2^192 values apart, so
+// that the lanes of Generate() do not run into the next stream) into
+// its own histogram, so nothing is shared while counting; the histograms
+// are merged at the end. sample(engine, span) fills a buffer of values.
+// The result depends only on the seed and the number of threads.
+template <typename Histogram, typename Sampler>
+Histogram ParallelHistogram(const Histogram& empty, uint64_t count, uint64_t seed,
+                            unsigned threads, Sampler sample)
+{
+	using T = typename Histogram::value_type;
+	threads = max(1u, threads);
+	vector<Histogram> partial(threads, empty);
+	vector<thread> pool;
+	Xoshiro256StarStar engine(seed);
+	for ( unsigned t = 0; t < threads; ++t )
+	{
+		const uint64_t first = count * t / threads, last = count * (t + 1) / threads;
+		pool.emplace_back([&hist = partial[t], engine, first, last, &sample]() mutable
+		{
+			vector<T> buf(16 * 1024);
+			for ( uint64_t pos = first; pos < last; pos += buf.size() )
+			{
+				const span<T> s(buf.data(), min<uint64_t>(buf.size(), last - pos));
+				sample(engine, s);
+				hist.Add(span<const T>(s));
+			}
+		});
+		engine.LongJump();
+	}
+	for ( auto& thr : pool )  thr.join();
+	Histogram result = empty;
+	for ( const auto& h : partial )  result += h;
+	return result;
+}
+
+
+
+//-----------------------------------------------------------------------------
+
+
+// A replacement for srand()/rand(): every thread has its own generator, so
+// the calls never wait for each other. A thread gets its generator on first
+// use: the k-th thread to ask (counting from the last Seed()) gets the
+// stream of the master seed long-jumped k times. The streams never overlap,
+// and the same seed with the same order of threads gives the same numbers.
+class RandomSource
+{
+public:
+	static void Seed(uint64_t master_seed);  // Threads take new streams on their next call
+	static Xoshiro256StarStar& Engine();
+
+private:
+	static inline mutex mutex_;
+	static inline uint64_t master_seed_ = 0x5eed;  // Deterministic without Seed()
+	static inline uint64_t next_stream_ = 0;
+	static inline atomic<uint64_t> epoch_ {1};     // Incremented by Seed()
+
+	static uint64_t NewStream(Xoshiro256StarStar& engine);
+};
+
+
+
+void RandomSource::Seed(uint64_t master_seed)
+{
+	lock_guard lock(mutex_);
+	master_seed_ = master_seed;
+	next_stream_ = 0;
+	epoch_.fetch_add(1, memory_order_release);
+}
+
+
+
+// The lock is taken once per thread and seed
+uint64_t RandomSource::NewStream(Xoshiro256StarStar& engine)
+{
+	lock_guard lock(mutex_);
+	engine = Xoshiro256StarStar(master_seed_);
+	for ( uint64_t k = 0; k < next_stream_; ++k )  engine.LongJump();
+	++next_stream_;
+	return epoch_.load(memory_order_relaxed);
+}
+
+
+
+inline Xoshiro256StarStar& RandomSource::Engine()
+{
+	thread_local Xoshiro256StarStar engine;
+	thread_local uint64_t epoch = 0;
+	if ( epoch != epoch_.load(memory_order_acquire) ) [[unlikely]]
+		epoch = NewStream(engine);
+	return engine;
+}
+
+
+
+inline void SeedRandom(uint64_t master_seed)
+{
+	RandomSource::Seed(master_seed);
+}
+
+
+
+// Lemire's method as in UniformInt, but the division for the rejection
+// threshold is done only when the low word is small enough to need it.
+inline int64_t RandomInt(int64_t min, int64_t max)
+{
+	if ( max < min )  throw invalid_argument("RandomInt: max < min");
+	auto& engine = RandomSource::Engine();
+	const uint64_t range = static_cast<uint64_t>(max) - static_cast<uint64_t>(min) + 1;
+	if ( range == 0 )  return static_cast<int64_t>(engine());
+	unsigned __int128 m = static_cast<unsigned __int128>(engine()) * range;
+	if ( static_cast<uint64_t>(m) < range )
+	{
+		const uint64_t threshold = (0 - range) % range;
+		while ( static_cast<uint64_t>(m) < threshold )
+			m = static_cast<unsigned __int128>(engine()) * range;
+	}
+	return static_cast<int64_t>(static_cast<uint64_t>(min) + static_cast<uint64_t>(m >> 64));
+}
+
+
+
+// [a, b) from the mantissa bits, as UniformReal<double>
+inline double RandomReal(double a, double b)
+{
+	if ( !(a < b) )  throw invalid_argument("RandomReal: empty interval");
+	const double u = bit_cast<double>((RandomSource::Engine()() >> 12) | 0x3ff0000000000000u) - 1.0;
+	const double r = a + (b - a) * u;
+	return r < b ? r : nextafter(b, a);  // Rounding may give b
+}
+
+
+
+//-----------------------------------------------------------------------------
+
+
+template <typename F>
+double TimeSec(F f)
+{
+	const auto t = chrono::steady_clock::now();
+	f();
+	return chrono::duration<double>(chrono::steady_clock::now() - t).count();
+}
+
+
+
+volatile uint64_t sink;  // Keeps the compiler from dropping unused results
+
+void Report(const char* name, size_t count, size_t bytes_per_value, double sec)
+{
+	cout << setw(32) << left << name << right << setw(6) << sec * 1e9 / count
+	     << " ns/value " << setw(7) << count * bytes_per_value / sec / 1e9 << " GB/s\n";
+}
+
+template <typename Engine>
+void BenchmarkEngine(const char* name, const Engine& original, size_t count)
+{
+	Engine engine = original;  // A local copy stays in registers
+	uint64_t acc = 0;
+	const double sec = TimeSec([&]{ for ( size_t i = 0; i < count; ++i )  acc += engine(); });
+	sink = acc;
+	Report(name, count, (bit_width(Engine::max() - Engine::min()) + 7) / 8, sec);
+}
+
+template <typename Engine>
+void BenchmarkGenerate(const char* name, Engine& engine, vector<uint64_t>& buf, size_t rounds)
+{
+	const double sec = TimeSec([&]{ for ( size_t r = 0; r < rounds; ++r )  engine.Generate(buf); });
+	sink = buf[buf.size() / 2];
+	Report(name, buf.size() * rounds, sizeof(uint64_t), sec);
+}
+
+
+
+void EnginesDemo()
+{
+	SplitMix64 sm(1);
+	Xoshiro256StarStar xs(1);
+	Pcg64 pcg(1);
+	for ( int i = 0; i < 3; ++i )  cout << sm() << ' ' << xs() << ' ' << pcg() << '\n';
+
+	// Like any UniformRandomBitGenerator they work with std:: distributions
+	uniform_int_distribution<int> distr(1, 6);
+	for ( int i = 0; i < 20; ++i )  cout << distr(xs) << ' ';
+	cout << '\n';
+
+	SplitMix64 a(7), b(7);
+	vector<uint64_t> buf(5);
+	b.Generate(buf);
+	for ( uint64_t v : buf )  cout << (a() == v);
+	cout << " (bulk SplitMix64 matches the scalar sequence)\n\n";
+}
+
+
+
+void EnginesBenchmark()
+{
+	const size_t count = 100'000'000;
+	cout << fixed << setprecision(2);
+	{
+		mt19937 e(1);
+		BenchmarkEngine("mt19937 (32-bit)", e, count);
+	}
+	{
+		mt19937_64 e(1);
+		BenchmarkEngine("mt19937_64", e, count);
+	}
+	{
+		minstd_rand e(1);
+		BenchmarkEngine("minstd_rand (31-bit)", e, count);
+	}
+	{
+		srand(1);
+		uint64_t acc = 0;
+		const double sec = TimeSec([&]{ for ( size_t i = 0; i < count; ++i )  acc += rand(); });
+		sink = acc;
+		Report("rand() (31-bit)", count, sizeof(int), sec);
+	}
+	SplitMix64 sm(1);
+	Xoshiro256StarStar xs(1);
+	Pcg64 pcg(1);
+	BenchmarkEngine("SplitMix64", sm, count);
+	BenchmarkEngine("Xoshiro256StarStar", xs, count);
+	BenchmarkEngine("Pcg64", pcg, count);
+
+	vector<uint64_t> buf(16 * 1024);  // 128 KB, stays in L2
+	const size_t rounds = count / buf.size();
+	BenchmarkGenerate("SplitMix64::Generate", sm, buf, rounds);
+	BenchmarkGenerate("Xoshiro256StarStar::Generate", xs, buf, rounds);
+	BenchmarkGenerate("Pcg64::Generate", pcg, buf, rounds);
+}
+
+
+
+inline int GetRandom(int min, int max)  // From random_numbers.cpp
+{
+	return min + rand() / ((RAND_MAX + 1u) / (max - min + 1));
+}
+
+
+
+void DistributionsDemo()
+{
+	Xoshiro256StarStar gen(2024);  // The same output with any standard library
+	const UniformInt<int16_t> dice(1, 6);
+	for ( int i = 0; i < 20; ++i )  cout << dice(gen) << ' ';
+	cout << '\n';
+
+	vector<int16_t> digits(20'000);
+	UniformInt<int16_t>(0, 9).Fill(gen, span(digits));
+	map<int16_t, uint16_t> hist;
+	for ( auto d : digits )  ++hist[d];
+	for ( auto p : hist )
+		cout << p.first << " : " << string(p.second / 100, '*') << '\n';
+
+	const UniformReal<float> real(-1.0, 1.0);
+	for ( uint8_t i = 0; i < 5; ++i )  cout << real(gen) << ' ';
+	cout << "\n\n";
+}
+
+
+
+void DistributionsBenchmark()
+{
+	const size_t count = 50'000'000;
+	vector<int16_t> ints(count);
+	vector<float> floats(count);
+	vector<double> doubles(count);
+	Xoshiro256StarStar xs(1);
+	mt19937 mt(1);
+	uint64_t acc = 0;
+	auto report = [&](const char* name, size_t bytes, double sec)
+	{
+		sink = acc;
+		Report(name, count, bytes, sec);
+	};
+
+	srand(1);
+	report("GetRandom(1, 6) (rand)", 2, TimeSec([&]{
+		for ( size_t i = 0; i < count; ++i )  acc += GetRandom(1, 6); }));
+	uniform_int_distribution<int16_t> std_int(1, 6);
+	report("uniform_int_distribution mt", 2, TimeSec([&]{
+		for ( size_t i = 0; i < count; ++i )  acc += std_int(mt); }));
+	report("uniform_int_distribution xs", 2, TimeSec([&]{
+		for ( size_t i = 0; i < count; ++i )  acc += std_int(xs); }));
+	const UniformInt<int16_t> fast_int(1, 6);
+	report("UniformInt", 2, TimeSec([&]{
+		for ( size_t i = 0; i < count; ++i )  acc += fast_int(xs); }));
+	report("UniformInt::Fill", 2, TimeSec([&]{ fast_int.Fill(xs, span(ints)); }));
+
+	uniform_real_distribution<float> std_float(-1.0, 1.0);
+	report("uniform_real_dist<float> mt", 4, TimeSec([&]{
+		for ( size_t i = 0; i < count; ++i )  floats[i] = std_float(mt); }));
+	const UniformReal<float> fast_float(-1.0, 1.0);
+	report("UniformReal<float>", 4, TimeSec([&]{
+		for ( size_t i = 0; i < count; ++i )  floats[i] = fast_float(xs); }));
+	report("UniformReal<float>::Fill", 4, TimeSec([&]{ fast_float.Fill(xs, span(floats)); }));
+
+	uniform_real_distribution<double> std_double(-1.0, 1.0);
+	report("uniform_real_dist<double> mt", 8, TimeSec([&]{
+		for ( size_t i = 0; i < count; ++i )  doubles[i] = std_double(mt); }));
+	const UniformReal<double> fast_double(-1.0, 1.0);
+	report("UniformReal<double>::Fill", 8, TimeSec([&]{ fast_double.Fill(xs, span(doubles)); }));
+	cout << '\n';
+}
+
+
+
+template <typename T>
+void PrintMoments(const char* name, span<const T> v)
+{
+	double mean = 0, sq = 0;
+	for ( T x : v )  mean += x;
+	mean /= v.size();
+	for ( T x : v )  sq += (x - mean) * (x - mean);
+	cout << name << ": mean " << mean << ", variance " << sq / (v.size() - 1) << '\n';
+}
+
+
+
+void SamplersDemo()
+{
+	Xoshiro256StarStar gen(5);
+	const vector<double> weights {1, 2, 3, 4};  // Outcome k has probability (k+1)/10
+	const AliasTable table(weights);
+	vector<uint32_t> outcomes(100'000);
+	table.Fill(gen, span(outcomes));
+	array<int, 4> hist {};
+	for ( uint32_t k : outcomes )  ++hist[k];
+	for ( size_t k = 0; k < hist.size(); ++k )
+		cout << k << " : " << string(hist[k] / 1000, '*') << '\n';
+
+	vector<double> v(1'000'000);
+	NormalZiggurat(10, 2).Fill(gen, span(v));
+	PrintMoments<double>("NormalZiggurat(10, 2)", v);
+	for ( auto& x : v )  x = NormalZiggurat(10, 2)(gen);
+	PrintMoments<double>("NormalZiggurat(10, 2) scalar", v);
+	ExponentialZiggurat(4).Fill(gen, span(v));
+	PrintMoments<double>("ExponentialZiggurat(4)", v);
+	cout << '\n';
+}
+
+
+
+void SamplersBenchmark()
+{
+	const size_t count = 20'000'000;
+	Xoshiro256StarStar xs(1);
+	mt19937_64 mt(1);
+	uint64_t acc = 0;
+	double dacc = 0;
+	auto report = [&](const string& name, size_t bytes, double sec)
+	{
+		sink = acc + static_cast<uint64_t>(dacc);
+		Report(name.c_str(), count, bytes, sec);
+	};
+
+	for ( size_t n : {1'000, 100'000} )
+	{
+		vector<double> weights(n);
+		UniformReal<double> w(0, 1);
+		for ( auto& x : weights )  x = w(xs);
+		discrete_distribution<uint32_t> std_discrete(weights.begin(), weights.end());
+		const AliasTable table(weights);
+		vector<uint32_t> out(count);
+		const string suffix = " (" + to_string(n) + ")";
+		report("discrete_distribution" + suffix, 4, TimeSec([&]{
+			for ( size_t i = 0; i < count; ++i )  acc += std_discrete(xs); }));
+		report("AliasTable" + suffix, 4, TimeSec([&]{
+			for ( size_t i = 0; i < count; ++i )  acc += table(xs); }));
+		report("AliasTable::Fill" + suffix, 4, TimeSec([&]{ table.Fill(xs, span(out)); }));
+		acc += out[count / 2];
+	}
+
+	vector<double> out(count);
+	normal_distribution<double> std_normal(0, 1);
+	report("normal_distribution mt", 8, TimeSec([&]{
+		for ( size_t i = 0; i < count; ++i )  dacc += std_normal(mt); }));
+	report("normal_distribution xs", 8, TimeSec([&]{
+		for ( size_t i = 0; i < count; ++i )  dacc += std_normal(xs); }));
+	const NormalZiggurat normal;
+	report("NormalZiggurat", 8, TimeSec([&]{
+		for ( size_t i = 0; i < count; ++i )  dacc += normal(xs); }));
+	report("NormalZiggurat::Fill", 8, TimeSec([&]{ normal.Fill(xs, span(out)); }));
+
+	exponential_distribution<double> std_exp(1);
+	report("exponential_distribution xs", 8, TimeSec([&]{
+		for ( size_t i = 0; i < count; ++i )  dacc += std_exp(xs); }));
+	const ExponentialZiggurat exponential;
+	report("ExponentialZiggurat", 8, TimeSec([&]{
+		for ( size_t i = 0; i < count; ++i )  dacc += exponential(xs); }));
+	report("ExponentialZiggurat::Fill", 8, TimeSec([&]{ exponential.Fill(xs, span(out)); }));
+	cout << '\n';
+}
+
+
+
+void HistogramsDemo()
+{
+	const UniformInt<int16_t> digit(0, 9);
+	const auto digits = ParallelHistogram(IntHistogram<int16_t>(0, 9), 20'000, 1, 4,
+		[&](auto& engine, span<int16_t> out) { digit.Fill(engine, out); });
+	digits.Print(cout, 100);
+
+	// A narrow type with a negative minimum, and values beyond both ends
+	const UniformInt<int8_t> die(1, 6);
+	Xoshiro256StarStar xs(1);
+	vector<int8_t> first(6'000), second(6'000);
+	die.Fill(xs, span(first));
+	die.Fill(xs, span(second));
+	IntHistogram<int8_t> differences(-4, 4);
+	for ( size_t i = 0; i < first.size(); ++i )  first[i] -= second[i];
+	differences.Add(span<const int8_t>(first));
+	differences.Add(INT8_MIN);
+	differences.Add(INT8_MAX);
+	differences.Print(cout, 50);
+	cout << "Outside [-4, 4]: " << differences.Underflow() << " below, "
+	     << differences.Overflow() << " above\n\n";
+
+	const NormalZiggurat normal;
+	const auto normals = ParallelHistogram(RealHistogram<double>(-3, 3, 12), 1'000'000, 1, 4,
+		[&](auto& engine, span<double> out) { normal.Fill(engine, out); });
+	normals.Print(cout, 4'000);
+	cout << "Outside [-3, 3): " << normals.Underflow() + normals.Overflow() << "\n\n";
+}
+
+
+
+void HistogramsBenchmark()
+{
+	const size_t count = 50'000'000;
+	Xoshiro256StarStar xs(1);
+	uint64_t acc = 0;
+	for ( int16_t max : {9, 999} )
+	{
+		vector<int16_t> values(count);
+		UniformInt<int16_t>(0, max).Fill(xs, span(values));
+		const string suffix = " [0, " + to_string(max) + "]";
+		map<int16_t, uint64_t> tree;
+		Report(("map" + suffix).c_str(), count, 2, TimeSec([&]{
+			for ( auto v : values )  ++tree[v]; }));
+		IntHistogram<int16_t> one(0, max), block(0, max);
+		Report(("IntHistogram::Add" + suffix).c_str(), count, 2, TimeSec([&]{
+			for ( auto v : values )  one.Add(v); }));
+		Report(("IntHistogram::Add span" + suffix).c_str(), count, 2, TimeSec([&]{
+			block.Add(span<const int16_t>(values)); }));
+		acc += tree[max / 2] + one[max / 2] + block[max / 2];
+	}
+
+	vector<double> reals(count);
+	UniformReal<double>(-1, 1).Fill(xs, span(reals));
+	RealHistogram<double> real_hist(-1, 1, 100);
+	Report("RealHistogram::Add span", count, 8, TimeSec([&]{
+		real_hist.Add(span<const double>(reals)); }));
+	acc += real_hist.Bin(50);
+	sink = acc;
+
+	// Sampling and counting together; scales with the number of cores
+	const UniformInt<int16_t> distr(0, 999);
+	auto sample = [&](auto& engine, span<int16_t> out) { distr.Fill(engine, out); };
+	const unsigned cores = thread::hardware_concurrency();
+	for ( unsigned threads : {1u, cores} )
+	{
+		const string name = "ParallelHistogram (" + to_string(threads) + " threads)";
+		const uint64_t n = 4 * count;
+		Report(name.c_str(), n, 2, TimeSec([&]{
+			sink = ParallelHistogram(IntHistogram<int16_t>(0, 999), n, 1, threads, sample)[500]; }));
+		if ( cores == 1 )  break;
+	}
+	cout << '\n';
+}
+
+
+
+void RandomSourceDemo()
+{
+	auto draw = [](const char* who)
+	{
+		cout << who << ':';
+		for ( int i = 0; i < 10; ++i )  cout << ' ' << RandomInt(1, 6);
+		cout << "  " << RandomReal(-1, 1) << '\n';
+	};
+	for ( int run = 0; run < 2; ++run )  // Both runs print the same
+	{
+		SeedRandom(42);
+		draw("main    ");
+		thread(draw, "thread 1").join();
+		thread(draw, "thread 2").join();
+	}
+	cout << '\n';
+}
+
+
+
+// Every thread makes 'count' calls; the time is the wall time of all threads
+void RandomSourceBenchmark()
+{
+	const size_t count = 20'000'000;
+	const unsigned cores = thread::hardware_concurrency();
+	auto run = [&](const char* name, unsigned threads, auto call)
+	{
+		vector<thread> pool;
+		vector<int64_t> sums(threads);  // One per thread: 'sink' is written only after join()
+		const double sec = TimeSec([&]
+		{
+			for ( unsigned t = 0; t < threads; ++t )
+				pool.emplace_back([&, t]
+				{
+					int64_t acc = 0;
+					for ( size_t i = 0; i < count; ++i )  acc += call();
+					sums[t] = acc;
+				});
+			for ( auto& thr : pool )  thr.join();
+		});
+		sink = accumulate(sums.begin(), sums.end(), int64_t {0});
+		const string label = string(name) + " (" + to_string(threads) + " threads)";
+		Report(label.c_str(), count * threads, sizeof(int), sec);
+	};
+	srand(1);
+	SeedRandom(1);
+	for ( unsigned threads = 1; ; threads = min(2 * threads, cores) )
+	{
+		run("GetRandom(1, 6)", threads, []{ return GetRandom(1, 6); });
+		run("RandomInt(1, 6)", threads, []{ return RandomInt(1, 6); });
+		if ( threads >= cores )  break;
+	}
+	cout << '\n';
+}
+
+
+
+int main()
+{
+	EnginesDemo();
+	EnginesBenchmark();
+	cout << '\n';
+	DistributionsDemo();
+	DistributionsBenchmark();
+	SamplersDemo();
+	SamplersBenchmark();
+	HistogramsDemo();
+	HistogramsBenchmark();
+	RandomSourceDemo();
+	RandomSourceBenchmark();
+}
@@ -0,0 +1,436 @@
+/*****************************************************************************
+ * This model program demonstrates a dense matrix with a cache-blocked,
+ * multithreaded matrix multiplication (GEMM) built around a register-blocked
+ * micro-kernel, and GEMV and dot product built on the same ideas.
+ * g++ matrix_multiply.cpp -std=c++20 -O3 -march=native -pthread -o matrix_multiply
+ *****************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+
+
+class Matrix  // Row-major dense matrix
+{
+public:
+	Matrix(size_t rows, size_t cols, double value = 0)
+		: rows_ {rows}, cols_ {cols}, data_(rows * cols, value) {}
+
+	size_t Rows() const { return rows_; }
+	size_t Cols() const { return cols_; }
+	double& operator()(size_t i, size_t j) { return data_[i * cols_ + j]; }
+	double operator()(size_t i, size_t j) const { return data_[i * cols_ + j]; }
+	double* Data() { return data_.data(); }
+	const double* Data() const { return data_.data(); }
+	span<const double> Row(size_t i) const { return {&data_[i * cols_], cols_}; }
+
+private:
+	size_t rows_;
+	size_t cols_;
+	vector<double> data_;
+};
+
+
+
+// Threads started once and reused, so that a parallel loop costs a wake-up
+// of the workers rather than creating and joining threads: Gemm() runs one
+// per panel of B. The calling thread runs part 0 itself. While the pool is
+// busy (a call from another thread, or from inside a part), Run() calls
+// the parts one after another instead of waiting for it.
+class WorkerPool
+{
+public:
+	explicit WorkerPool(unsigned threads);
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator =(const WorkerPool&) = delete;
+	~WorkerPool();
+
+	static WorkerPool& Instance()
+	{
+		static WorkerPool pool(thread::hardware_concurrency());
+		return pool;
+	}
+
+	size_t Size() const { return workers_.size() + 1; }
+	// f(0) ... f(parts - 1). If a part throws, the parts not yet started are
+	// skipped, and the first exception is rethrown once all threads are done.
+	void Run(size_t parts, const function<void(size_t)>& f);
+
+private:
+	mutex run_mutex_;  // One Run() at a time
+	mutex mutex_;
+	condition_variable start_;
+	condition_variable done_;
+	const function<void(size_t)>* job_ = nullptr;
+	size_t parts_ = 0;
+	size_t next_ = 0;     // The next part to take
+	size_t pending_ = 0;  // Parts taken by the workers and not finished
+	exception_ptr error_;
+	bool stop_ = false;
+	vector<thread> workers_;
+
+	void Work();
+	void Cancel(exception_ptr error);
+};
+
+
+
+WorkerPool::WorkerPool(unsigned threads)
+{
+	for ( unsigned i = 1; i < threads; ++i )  workers_.emplace_back(&WorkerPool::Work, this);
+}
+
+
+
+WorkerPool::~WorkerPool()
+{
+	{
+		lock_guard lock(mutex_);
+		stop_ = true;
+	}
+	start_.notify_all();
+	for ( auto& thr : workers_ )  thr.join();
+}
+
+
+
+void WorkerPool::Run(size_t parts, const function<void(size_t)>& f)
+{
+	unique_lock run(run_mutex_, try_to_lock);
+	if ( !run || parts < 2 || workers_.empty() )
+	{
+		for ( size_t part = 0; part < parts; ++part )  f(part);
+		return;
+	}
+	{
+		lock_guard lock(mutex_);
+		job_ = &f;
+		parts_ = parts;
+		next_ = 1;
+		pending_ = parts - 1;
+	}
+	start_.notify_all();
+	exception_ptr error;
+	try { f(0); } catch ( ... ) { error = current_exception(); }
+	unique_lock lock(mutex_);
+	if ( error )  Cancel(error);
+	while ( next_ < parts_ )  // Parts the workers have not taken yet
+	{
+		const size_t part = next_++;
+		lock.unlock();
+		try { f(part); } catch ( ... ) { error = current_exception(); }
+		lock.lock();
+		if ( error )  Cancel(error);
+		--pending_;
+	}
+	done_.wait(lock, [this]{ return pending_ == 0; });  // The workers still use f
+	error = exchange(error_, nullptr);
+	lock.unlock();
+	if ( error )  rethrow_exception(error);
+}
+
+
+
+// Called with mutex_ held: keeps the first exception and drops the parts
+// nobody has taken yet
+void WorkerPool::Cancel(exception_ptr error)
+{
+	if ( !error_ )  error_ = move(error);
+	pending_ -= parts_ - next_;
+	next_ = parts_;
+}
+
+
+
+void WorkerPool::Work()
+{
+	unique_lock lock(mutex_);
+	for ( ; ; )
+	{
+		start_.wait(lock, [this]{ return stop_ || next_ < parts_; });
+		if ( stop_ )  return;
+		const size_t part = next_++;
+		lock.unlock();
+		exception_ptr error;
+		try { (*job_)(part); } catch ( ... ) { error = current_exception(); }
+		lock.lock();
+		if ( error )  Cancel(move(error));
+		if ( --pending_ == 0 )  done_.notify_one();
+	}
+}
+
+
+
+// Splits [0, count) into contiguous chunks, one per thread of the pool.
+template <typename F>
+void ParallelFor(size_t count, unsigned threads, F f)
+{
+	WorkerPool& pool = WorkerPool::Instance();
+	const size_t parts = max<size_t>(1, min({size_t {threads}, count, pool.Size()}));
+	if ( parts == 1 ) { f(size_t {0}, count); return; }
+	const size_t chunk = (count + parts - 1) / parts;
+	pool.Run(parts, [&](size_t part)
+	{
+		const size_t begin = part * chunk;
+		if ( begin < count )  f(begin, min(begin + chunk, count));
+	});
+}
+
+
+
+// Block sizes: an MR x NR block of C lives in registers, a KC x NR sliver of
+// B in L1, an MC x KC block of A in L2 and a KC x NC panel of B in L3.
+constexpr size_t MR = 4, NR = 8;
+constexpr size_t MC = 128, KC = 256, NC = 4096;
+
+
+
+// C[MR x NR] += A sliver * B sliver. The fixed-size inner loops are unrolled
+// and vectorized by the compiler; 'mr' and 'nr' are smaller only at the edges.
+void MicroKernel(size_t kc, const double* a, const double* b,
+                 double* c, size_t ldc, size_t mr, size_t nr)
+{
+	double acc[MR][NR] = {};
+	for ( size_t p = 0; p < kc; ++p, a += MR, b += NR )
+		for ( size_t i = 0; i < MR; ++i )
+			for ( size_t j = 0; j < NR; ++j )
+				acc[i][j] += a[i] * b[j];
+	for ( size_t i = 0; i < mr; ++i )
+		for ( size_t j = 0; j < nr; ++j )
+			c[i * ldc + j] += acc[i][j];
+}
+
+
+
+// Packs an mc x kc block of A into slivers of MR rows stored column by column,
+// padding the last sliver with zeros.
+void PackA(const Matrix& a, size_t i0, size_t p0, size_t mc, size_t kc, double* dst)
+{
+	for ( size_t ir = 0; ir < mc; ir += MR )
+		for ( size_t p = 0; p < kc; ++p )
+			for ( size_t i = 0; i < MR; ++i )
+				*dst++ = (ir + i < mc) ? a(i0 + ir + i, p0 + p) : 0;
+}
+
+
+
+// Packs a kc x nc panel of B into slivers of NR columns stored row by row.
+void PackB(const Matrix& b, size_t p0, size_t j0, size_t kc, size_t nc, double* dst)
+{
+	for ( size_t jr = 0; jr < nc; jr += NR )
+		for ( size_t p = 0; p < kc; ++p )
+			for ( size_t j = 0; j < NR; ++j )
+				*dst++ = (jr + j < nc) ? b(p0 + p, j0 + jr + j) : 0;
+}
+
+
+
+// C = A * B
+void Gemm(const Matrix& a, const Matrix& b, Matrix& c,
+          unsigned threads = thread::hardware_concurrency())
+{
+	const size_t m = a.Rows(), k = a.Cols(), n = b.Cols();
+	if ( b.Rows() != k || c.Rows() != m || c.Cols() != n )
+		throw invalid_argument("Gemm: matrix dimensions do not match");
+	fill(c.Data(), c.Data() + m * n, 0.0);
+
+	vector<double> packed_b(KC * ((min(NC, n) + NR - 1) / NR * NR));
+	const size_t blocks = (m + MC - 1) / MC;
+	for ( size_t jc = 0; jc < n; jc += NC )
+	{
+		const size_t nc = min(NC, n - jc);
+		for ( size_t pc = 0; pc < k; pc += KC )
+		{
+			const size_t kc = min(KC, k - pc);
+			PackB(b, pc, jc, kc, nc, packed_b.data());
+			// Row blocks of C are independent: every thread packs its own A
+			ParallelFor(blocks, threads, [&](size_t first, size_t last)
+			{
+				vector<double> packed_a(MC * KC);
+				for ( size_t blk = first; blk < last; ++blk )
+				{
+					const size_t ic = blk * MC, mc = min(MC, m - ic);
+					PackA(a, ic, pc, mc, kc, packed_a.data());
+					for ( size_t jr = 0; jr < nc; jr += NR )
+						for ( size_t ir = 0; ir < mc; ir += MR )
+							MicroKernel(kc, &packed_a[ir * kc], &packed_b[jr * kc],
+							            &c(ic + ir, jc + jr), n,
+							            min(MR, mc - ir), min(NR, nc - jr));
+				}
+			});
+		}
+	}
+}
+
+
+
+const Matrix operator *(const Matrix& lhs, const Matrix& rhs)
+{
+	Matrix result(lhs.Rows(), rhs.Cols());
+	Gemm(lhs, rhs, result);
+	return result;
+}
+
+
+
+// Several independent accumulators break the dependency chain of the sum
+// and let the compiler keep a whole vector register busy per accumulator.
+double Dot(span<const double> x, span<const double> y)
+{
+	if ( x.size() != y.size() )  throw invalid_argument("Dot: sizes do not match");
+	constexpr size_t lanes = 8;
+	double acc[lanes] = {};
+	size_t i = 0;
+	for ( ; i + lanes <= x.size(); i += lanes )
+		for ( size_t l = 0; l < lanes; ++l )  acc[l] += x[i + l] * y[i + l];
+	double sum = 0;
+	for ( ; i < x.size(); ++i )  sum += x[i] * y[i];
+	for ( double v : acc )  sum += v;
+	return sum;
+}
+
+
+
+// y = A * x, rows are split between threads
+void Gemv(const Matrix& a, span<const double> x, span<double> y,
+          unsigned threads = thread::hardware_concurrency())
+{
+	if ( x.size() != a.Cols() || y.size() != a.Rows() )
+		throw invalid_argument("Gemv: dimensions do not match");
+	ParallelFor(a.Rows(), threads, [&](size_t first, size_t last)
+	{
+		for ( size_t i = first; i < last; ++i )  y[i] = Dot(a.Row(i), x);
+	});
+}
+
+
+
+void NaiveMultiply(const Matrix& a, const Matrix& b, Matrix& c)
+{
+	for ( size_t i = 0; i < a.Rows(); ++i )
+		for ( size_t j = 0; j < b.Cols(); ++j )
+		{
+			double sum = 0;
+			for ( size_t p = 0; p < a.Cols(); ++p )  sum += a(i, p) * b(p, j);
+			c(i, j) = sum;
+		}
+}
+
+
+
+// Row by column with inner_product(): every column of B is copied first
+void InnerProductMultiply(const Matrix& a, const Matrix& b, Matrix& c)
+{
+	vector<double> column(b.Rows());
+	for ( size_t j = 0; j < b.Cols(); ++j )
+	{
+		for ( size_t p = 0; p < b.Rows(); ++p )  column[p] = b(p, j);
+		for ( size_t i = 0; i < a.Rows(); ++i )
+			c(i, j) = inner_product(column.begin(), column.end(), a.Row(i).begin(), 0.0);
+	}
+}
+
+
+
+template <typename F>
+double TimeSec(F f)
+{
+	const auto t = chrono::steady_clock::now();
+	f();
+	return chrono::duration<double>(chrono::steady_clock::now() - t).count();
+}
+
+
+
+double MaxDiff(const Matrix& x, const Matrix& y)
+{
+	double d = 0;
+	for ( size_t i = 0; i < x.Rows() * x.Cols(); ++i )
+		d = max(d, abs(x.Data()[i] - y.Data()[i]));
+	return d;
+}
+
+
+
+void Benchmark(size_t m, size_t k, size_t n, mt19937& gen)
+{
+	uniform_real_distribution<double> distr(-1.0, 1.0);
+	Matrix a(m, k), b(k, n), c0(m, n), c1(m, n), c2(m, n), c3(m, n);
+	for ( size_t i = 0; i < m * k; ++i )  a.Data()[i] = distr(gen);
+	for ( size_t i = 0; i < k * n; ++i )  b.Data()[i] = distr(gen);
+	const double gflop = 2e-9 * m * k * n;
+	const unsigned threads = thread::hardware_concurrency();
+
+	const double t0 = TimeSec([&]{ NaiveMultiply(a, b, c0); });
+	const double t1 = TimeSec([&]{ InnerProductMultiply(a, b, c1); });
+	const double t2 = TimeSec([&]{ Gemm(a, b, c2, 1); });
+	const double t3 = TimeSec([&]{ Gemm(a, b, c3, threads); });
+	cout << m << 'x' << k << " * " << k << 'x' << n << ":  naive " << setw(5)
+	     << gflop / t0 << ", inner_product " << setw(5) << gflop / t1
+	     << ", blocked " << setw(5) << gflop / t2 << ", blocked (" << threads
+	     << " threads) " << setw(5) << gflop / t3 << " GFLOPS,  max diff "
+	     << scientific << max(MaxDiff(c1, c0), max(MaxDiff(c2, c0), MaxDiff(c3, c0)))
+	     << fixed << '\n';
+}
+
+
+
+int main()
+{
+	Matrix a(2, 3), b(3, 2);
+	double v = 1;
+	for ( size_t i = 0; i < 2; ++i )
+		for ( size_t j = 0; j < 3; ++j )  { a(i, j) = v; b(j, i) = v++; }
+	const Matrix c = a * b;
+	cout << c(0, 0) << ' ' << c(0, 1) << '\n' << c(1, 0) << ' ' << c(1, 1) << '\n';
+
+	vector<double> x {1, 1, 1}, y(2);
+	Gemv(a, x, y);
+	cout << "A * (1, 1, 1) = " << y[0] << ' ' << y[1] << '\n';
+	vector<double> p {0, 1, 2, 3, 4}, q {5, 4, 2, 3, 1};
+	cout << "Dot product: " << Dot(p, q) << '\n';
+	try
+	{
+		ParallelFor(100, 4, [](size_t begin, size_t end) {
+			if ( end == 100 )  throw runtime_error("[" + to_string(begin) + ", 100) failed");
+		});
+	}
+	catch ( const runtime_error& e )
+	{
+		cout << "ParallelFor: " << e.what() << "\n\n";
+	}
+
+	mt19937 gen(2024);
+	cout << fixed << setprecision(2);
+	Benchmark(512, 512, 512, gen);     // Square
+	Benchmark(1024, 1024, 1024, gen);
+	Benchmark(4096, 256, 16, gen);     // Tall and skinny result
+	Benchmark(16, 4096, 1024, gen);    // Short and wide result
+	Benchmark(2048, 32, 2048, gen);    // Outer-product-like, small k
+
+	const size_t size = 4096;
+	uniform_real_distribution<double> distr(-1.0, 1.0);
+	Matrix big(size, size);
+	for ( size_t i = 0; i < size * size; ++i )  big.Data()[i] = distr(gen);
+	vector<double> bx(size), by(size);
+	for ( auto& e : bx )  e = distr(gen);
+	const double t = TimeSec([&]{ Gemv(big, bx, by); });
+	cout << "\nGemv " << size << 'x' << size << ": " << 2e-9 * size * size / t
+	     << " GFLOPS\n";
+}
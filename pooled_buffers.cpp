@@ -0,0 +1,553 @@
+/*****************************************************************************
+ * This model program demonstrates SomeClass of ctors_oper=.cpp with its data
+ * arrays taken from a pool instead of new[]: arrays are rounded up to
+ * power-of-two size classes, each thread keeps free blocks of every class
+ * in a cache of its own and refills it from global free lists in batches,
+ * and copy assignment reuses the existing array when it is large enough.
+ * Allocation counters compare it with the original class.
+ * g++ pooled_buffers.cpp -std=c++20 -O2 -pthread -o pooled_buffers
+ *****************************************************************************/
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+using Size = uint32_t;
+using Data = int;
+
+
+
+// The class of ctors_oper=.cpp without the output of every call, kept as the
+// baseline; new_calls counts its new[].
+
+class NewSomeClass
+{
+public:
+	static inline atomic<size_t> new_calls = 0;
+
+	explicit NewSomeClass(Size size) : size_ {size}, p_data_ {Allocate(size)} {}
+	NewSomeClass(Size size, const string& name)
+		: size_ {size}, p_data_ {Allocate(size)}, name_ {name} {}
+	NewSomeClass(const NewSomeClass& other)
+		: size_ {other.size_}, p_data_ {Allocate(other.size_)}, name_ {other.name_}
+	{
+		memcpy(p_data_, other.p_data_, sizeof(Data) * size_);
+	}
+	NewSomeClass(NewSomeClass&& other)
+		: size_ {other.size_}, p_data_ {other.p_data_}, name_ {move(other.name_)}
+	{
+		other.size_ = 0;
+		other.p_data_ = nullptr;
+	}
+	~NewSomeClass() { delete[] p_data_; }
+
+	const NewSomeClass& operator =(const NewSomeClass& other)
+	{
+		if ( &other != this )
+		{
+			delete[] p_data_;
+			size_ = other.size_;
+			p_data_ = Allocate(size_);
+			name_ = other.name_;
+			memcpy(p_data_, other.p_data_, sizeof(Data) * size_);
+		}
+		return *this;
+	}
+	const NewSomeClass& operator =(NewSomeClass&& other)
+	{
+		if ( &other != this )
+		{
+			delete[] p_data_;
+			size_ = other.size_;
+			p_data_ = other.p_data_;
+			name_ = move(other.name_);
+			other.size_ = 0;
+			other.p_data_ = nullptr;
+		}
+		return *this;
+	}
+
+	const NewSomeClass& DoSomething(Data value)
+	{
+		for ( Size i = 0; i < size_; ++i )  p_data_[i] = value;
+		return *this;
+	}
+	Size size() const { return size_; }
+
+private:
+	Size size_ = 0;
+	Data* p_data_ = nullptr;
+	string name_ = "DefaultName";
+
+	static Data* Allocate(Size size)
+	{
+		new_calls.fetch_add(1, memory_order_relaxed);
+		return new Data[size];
+	}
+
+	friend ostream& operator <<(ostream& out, const NewSomeClass& sc)
+	{
+		out << sc.name_ << ":";
+		if ( sc.size_ == 0 )  out << " empty";
+		for ( Size i = 0; i < sc.size_; ++i )  out << ' ' << sc.p_data_[i];
+		return out;
+	}
+};
+
+
+
+//-----------------------------------------------------------------------------
+
+
+struct PoolStats
+{
+	size_t requests = 0;   // Allocate() calls
+	size_t cached = 0;     // Served from the thread cache
+	size_t transfers = 0;  // Batches moved between a thread cache and the global lists
+	size_t system = 0;     // Calls to operator new: chunks of blocks and large arrays
+
+	const PoolStats& operator +=(const PoolStats& other)
+	{
+		requests += other.requests;
+		cached += other.cached;
+		transfers += other.transfers;
+		system += other.system;
+		return *this;
+	}
+};
+
+
+
+// Blocks of 16 bytes to 64 KB in power-of-two size classes; larger arrays
+// go to operator new. A thread takes and returns blocks through its own
+// free lists without locking. An empty list is refilled with a batch of
+// blocks from the global lists (or from a new 64 KB chunk), and a list that
+// grew beyond two batches gives one back, so memory freed by one thread is
+// reused by others. Chunks are released only at exit.
+class BufferPool
+{
+public:
+	static constexpr size_t min_block = 16;
+	static constexpr size_t max_block = 64 << 10;
+
+	static size_t BlockSize(size_t bytes)  // bytes if larger than max_block
+	{
+		return bytes <= min_block ? min_block : bytes > max_block ? bytes : bit_ceil(bytes);
+	}
+	static void* Allocate(size_t block_size);     // block_size from BlockSize()
+	static void Deallocate(void* p, size_t block_size);
+	static PoolStats Stats();  // Of exited threads and of the calling one
+
+private:
+	struct FreeBlock { FreeBlock* next; };
+
+	static constexpr size_t size_classes = 13;  // 16 B .. 64 KB
+	static constexpr size_t chunk_size = 64 << 10;
+
+	struct ThreadCache
+	{
+		FreeBlock* lists[size_classes] {};
+		size_t counts[size_classes] {};
+		PoolStats stats;
+
+		~ThreadCache();
+	};
+
+	static thread_local ThreadCache cache_;
+	static inline mutex mutex_;  // For the members below
+	static inline FreeBlock* lists_[size_classes] {};
+	static inline vector<unique_ptr<char[]>> chunks_;
+	static inline PoolStats exited_;
+
+	static size_t Class(size_t block_size) { return countr_zero(block_size / min_block); }
+	static size_t Batch(size_t c) { return clamp<size_t>((16 << 10) / (min_block << c), 1, 32); }
+	static void Refill(ThreadCache& cache, size_t c);
+	static void Release(ThreadCache& cache, size_t c, size_t count);
+};
+
+thread_local BufferPool::ThreadCache BufferPool::cache_;
+
+
+
+void* BufferPool::Allocate(size_t block_size)
+{
+	ThreadCache& cache = cache_;
+	++cache.stats.requests;
+	if ( block_size > max_block )
+	{
+		++cache.stats.system;
+		return ::operator new(block_size);
+	}
+	const size_t c = Class(block_size);
+	if ( cache.lists[c] )  ++cache.stats.cached;
+	else  Refill(cache, c);
+	FreeBlock* block = cache.lists[c];
+	cache.lists[c] = block->next;
+	--cache.counts[c];
+	return block;
+}
+
+
+
+void BufferPool::Deallocate(void* p, size_t block_size)
+{
+	if ( block_size > max_block )
+	{
+		::operator delete(p);
+		return;
+	}
+	ThreadCache& cache = cache_;
+	const size_t c = Class(block_size);
+	cache.lists[c] = new (p) FreeBlock {cache.lists[c]};
+	if ( ++cache.counts[c] > 2 * Batch(c) )  Release(cache, c, Batch(c));
+}
+
+
+
+// Takes up to a batch from the global list, or carves a new chunk
+void BufferPool::Refill(ThreadCache& cache, size_t c)
+{
+	const size_t size = min_block << c, batch = Batch(c);
+	++cache.stats.transfers;
+	lock_guard lock(mutex_);
+	if ( !lists_[c] )
+	{
+		++cache.stats.system;
+		char* chunk = chunks_.emplace_back(make_unique_for_overwrite<char[]>(chunk_size)).get();
+		for ( size_t offset = chunk_size; offset >= size; offset -= size )
+			lists_[c] = new (chunk + offset - size) FreeBlock {lists_[c]};
+	}
+	for ( size_t i = 0; i < batch && lists_[c]; ++i )
+	{
+		FreeBlock* block = lists_[c];
+		lists_[c] = block->next;
+		block->next = cache.lists[c];
+		cache.lists[c] = block;
+		++cache.counts[c];
+	}
+}
+
+
+
+void BufferPool::Release(ThreadCache& cache, size_t c, size_t count)
+{
+	++cache.stats.transfers;
+	lock_guard lock(mutex_);
+	for ( ; count > 0 && cache.lists[c]; --count )
+	{
+		FreeBlock* block = cache.lists[c];
+		cache.lists[c] = block->next;
+		block->next = lists_[c];
+		lists_[c] = block;
+		--cache.counts[c];
+	}
+}
+
+
+
+BufferPool::ThreadCache::~ThreadCache()
+{
+	for ( size_t c = 0; c < size_classes; ++c )
+		if ( counts[c] )  Release(*this, c, counts[c]);
+	lock_guard lock(mutex_);
+	exited_ += stats;
+}
+
+
+
+PoolStats BufferPool::Stats()
+{
+	lock_guard lock(mutex_);
+	PoolStats s = exited_;
+	return s += cache_.stats;
+}
+
+
+
+//-----------------------------------------------------------------------------
+
+
+// Copy assignment keeps the array if it holds other.size_ elements: the
+// size class of a block gives its capacity, and a smaller array only
+// leaves the rest of the block unused.
+class SomeClass
+{
+public:
+	SomeClass() = delete;
+	explicit SomeClass(Size size);
+	SomeClass(Size size, const string& name);
+	SomeClass(const SomeClass& other);
+	SomeClass(SomeClass&& other);
+
+	~SomeClass();
+
+	const SomeClass& operator =(const SomeClass& other);
+	const SomeClass& operator =(SomeClass&& other);
+
+	const SomeClass& DoSomething(Data value);
+	Size size() const { return size_; }
+
+	static inline atomic<size_t> reused = 0;  // Copy assignments that kept the array
+
+private:
+	Size size_ = 0;
+	Size capacity_ = 0;  // Elements in the block of p_data_
+	Data* p_data_ = nullptr;
+	string name_ = "DefaultName";
+
+	void Allocate(Size size);  // p_data_ is not owned yet
+	void Free();
+
+	friend ostream& operator <<(ostream& out, const SomeClass& sc);
+};
+
+
+
+void SomeClass::Allocate(Size size)
+{
+	size_ = size;
+	if ( size == 0 )
+	{
+		capacity_ = 0;
+		p_data_ = nullptr;
+		return;
+	}
+	const size_t block = BufferPool::BlockSize(sizeof(Data) * size);
+	capacity_ = static_cast<Size>(block / sizeof(Data));
+	p_data_ = static_cast<Data*>(BufferPool::Allocate(block));
+}
+
+
+
+void SomeClass::Free()
+{
+	if ( p_data_ )  BufferPool::Deallocate(p_data_, sizeof(Data) * capacity_);
+}
+
+
+
+SomeClass::SomeClass(Size size)
+{
+	Allocate(size);
+}
+
+
+
+SomeClass::SomeClass(Size size, const string& name)
+	: name_ {name}
+{
+	Allocate(size);
+}
+
+
+
+SomeClass::SomeClass(const SomeClass& other)
+	: name_ {other.name_}
+{
+	Allocate(other.size_);
+	if ( size_ )  memcpy(p_data_, other.p_data_, sizeof(Data) * size_);
+}
+
+
+
+SomeClass::SomeClass(SomeClass&& other)
+	: size_ {other.size_}, capacity_ {other.capacity_}, p_data_ {other.p_data_},
+	  name_ {move(other.name_)}
+{
+	other.size_ = other.capacity_ = 0;
+	other.p_data_ = nullptr;
+}
+
+
+
+SomeClass::~SomeClass()
+{
+	Free();
+}
+
+
+
+const SomeClass& SomeClass::operator =(const SomeClass& other)
+{
+	if ( &other != this )
+	{
+		if ( other.size_ <= capacity_ )
+		{
+			size_ = other.size_;
+			reused.fetch_add(1, memory_order_relaxed);
+		}
+		else
+		{
+			Free();
+			Allocate(other.size_);
+		}
+		name_ = other.name_;
+		if ( size_ )  memcpy(p_data_, other.p_data_, sizeof(Data) * size_);
+	}
+	return *this;
+}
+
+
+
+const SomeClass& SomeClass::operator =(SomeClass&& other)
+{
+	if ( &other != this )
+	{
+		Free();
+		size_ = other.size_;
+		capacity_ = other.capacity_;
+		p_data_ = other.p_data_;
+		name_ = move(other.name_);
+		other.size_ = other.capacity_ = 0;
+		other.p_data_ = nullptr;
+	}
+	return *this;
+}
+
+
+
+const SomeClass& SomeClass::DoSomething(Data value)
+{
+	for ( Size i = 0; i < size_; ++i )  p_data_[i] = value;
+	return *this;
+}
+
+
+
+ostream& operator <<(ostream& out, const SomeClass& sc)
+{
+	out << sc.name_ << ":";
+	if ( sc.size_ == 0 )  out << " empty";
+	for ( Size i = 0; i < sc.size_; ++i )  out << ' ' << sc.p_data_[i];
+	return out;
+}
+
+
+
+//-----------------------------------------------------------------------------
+
+
+template <typename F>
+double TimeSec(F f)
+{
+	const auto t = chrono::steady_clock::now();
+	f();
+	return chrono::duration<double>(chrono::steady_clock::now() - t).count();
+}
+
+
+
+// The calls of main() in ctors_oper=.cpp, except for vector<SomeClass> v(4),
+// which needs the deleted default constructor
+template <typename T>
+void Scenario()
+{
+	T sc2(5);
+	sc2.DoSomething(1);
+	T sc3(9, "ObjectName");
+	sc3.DoSomething(2);
+	T sc4(sc3);
+	T sc5 = sc3;
+	T sc6 {sc3};
+	sc6 = sc2;
+	sc6 = sc6;
+	sc2 = sc3 = sc4.DoSomething(3);
+	T sc7(move(sc2));
+	T sc8 = move(sc3);
+	T sc9 {move(sc4)};
+	sc9 = move(sc7);
+	sc9 = move(sc9);
+	vector<T> v;
+	v.push_back(T(10, "Foo"));
+	v.emplace_back(13, "Bar");
+	cout << "  " << sc9 << '\n';
+}
+
+
+
+// Objects of random sizes created, copy-assigned, moved and destroyed in
+// random order, as in a pool of messages or records
+template <typename T>
+void Churn(size_t operations, uint64_t seed)
+{
+	mt19937_64 gen(seed);
+	uniform_int_distribution<Size> size(1, 1000);
+	vector<T> objects;
+	for ( size_t i = 0; i < 256; ++i )  objects.emplace_back(size(gen));
+	for ( size_t i = 0; i < operations; ++i )
+	{
+		const uint64_t r = gen();
+		T& a = objects[r & 255];
+		const T& b = objects[(r >> 8) & 255];
+		switch ( (r >> 16) % 4 )
+		{
+		case 0:  a = T(size(gen), "Created");  break;
+		case 1:  a = b;  break;
+		case 2:  { T copy(b); a = move(copy); }  break;
+		default:  a.DoSomething(static_cast<Data>(r >> 32));
+		}
+	}
+}
+
+
+
+template <typename T>
+double ChurnTime(size_t operations, size_t threads)
+{
+	return TimeSec([&]{
+		vector<thread> workers;
+		for ( size_t t = 0; t < threads; ++t )
+			workers.emplace_back(Churn<T>, operations / threads, t + 1);
+		for ( auto& w : workers )  w.join();
+	});
+}
+
+
+
+void ChurnBenchmark()
+{
+	const size_t operations = 4'000'000;
+	for ( size_t threads : {1, 4} )
+	{
+		const size_t new_calls = NewSomeClass::new_calls;
+		const PoolStats before = BufferPool::Stats();
+		const double sec[] = {ChurnTime<NewSomeClass>(operations, threads),
+		                      ChurnTime<SomeClass>(operations, threads)};
+		const PoolStats s = BufferPool::Stats();
+		cout << "Churn, " << threads << " thread(s): new[] " << setw(5) << sec[0] * 1e9 / operations
+		     << " ns per operation, pool " << setw(5) << sec[1] * 1e9 / operations << " ns\n"
+		     << "  new[] calls " << NewSomeClass::new_calls - new_calls << ", pool requests "
+		     << s.requests - before.requests << ", operator new " << s.system - before.system
+		     << ", batch transfers " << s.transfers - before.transfers << '\n';
+	}
+}
+
+
+
+int main()
+{
+	cout << "The scenario of ctors_oper=.cpp:\n";
+	Scenario<NewSomeClass>();
+	Scenario<SomeClass>();
+	const PoolStats s = BufferPool::Stats();
+	cout << "  new[] calls " << NewSomeClass::new_calls << "; pool requests " << s.requests
+	     << " (" << s.cached << " from the thread cache), operator new " << s.system
+	     << ", copy assignments in place " << SomeClass::reused << '\n';
+	cout << '\n' << fixed << setprecision(1);
+	ChurnBenchmark();
+}
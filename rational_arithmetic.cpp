@@ -0,0 +1,1375 @@
+/*****************************************************************************
+ * This model program demonstrates rational numbers that never overflow
+ * silently, unlike the class of operator_overload.cpp: numerators and
+ * denominators are 64-bit, every operation is computed exactly with 128-bit
+ * intermediates, and a result that does not fit throws. In the lazy mode
+ * fractions are reduced only for output or when a result would not fit
+ * otherwise, which saves most of the gcd calls in long sums. Arrays of
+ * rationals are reduced, added, multiplied and compared in SIMD batches with
+ * a branch-free binary gcd. Reduced fields are a canonical form to hash,
+ * and a flat map orders keys by a double approximation with an exact
+ * tie-break. Text is parsed and formatted over buffers with from_chars and
+ * to_chars, several times faster than with streams.
+ * g++ rational_arithmetic.cpp -std=c++20 -O3 -march=native -o rational_arithmetic
+ *****************************************************************************/
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <numeric>
+#include <random>
+#include <set>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+
+
+// The class of operator_overload.cpp (only what the benchmarks need), kept
+// as the baseline. Products of int overflow silently.
+
+int Euclid(int a, int b)
+{
+	while ( a % b )
+	{
+		int temp = a;
+		a = b;
+		b = temp % b;
+	}
+	return abs(b);
+}
+
+
+
+class IntRational
+{
+public:
+	IntRational(int p, int q) : p_ {p}, q_ {q}
+	{
+		if ( q_ < 0 ) { p_ = -p_; q_ = -q_; }
+		Reduce();
+	}
+	const IntRational& operator +=(const IntRational& other)
+	{
+		p_ = p_ * other.q_ + other.p_ * q_;
+		q_ *= other.q_;
+		Reduce();
+		return *this;
+	}
+	friend bool operator <(const IntRational& lhs, const IntRational& rhs)  // For sets and maps
+	{
+		return lhs.p_ * rhs.q_ - rhs.p_ * lhs.q_ < 0;
+	}
+
+private:
+	int p_;
+	int q_;
+	void Reduce()
+	{
+		const int k = Euclid(p_, q_);
+		p_ /= k;
+		q_ /= k;
+	}
+
+	friend ostream& operator <<(ostream& os, const IntRational& r)
+	{
+		return os << r.p_ << '/' << r.q_;
+	}
+};
+
+
+
+//-----------------------------------------------------------------------------
+
+
+using int128 = __int128;  // GCC and Clang extension
+using uint128 = unsigned __int128;
+
+constexpr int64_t rational_max = numeric_limits<int64_t>::max();
+
+inline bool Fits(int128 x) { return x >= -rational_max && x <= rational_max; }
+
+
+
+inline uint64_t Magnitude(int64_t x)  // |x| without overflow for INT64_MIN, no branch
+{
+	const uint64_t sign = x >> 63;
+	return (static_cast<uint64_t>(x) ^ sign) - sign;
+}
+
+
+
+// Stein's binary gcd: shifts and subtractions instead of the divisions of
+// Euclid and std::gcd. The difference b - a is computed before min(a, b),
+// so the two do not wait for each other, and the loop has no branch besides
+// the exit.
+uint64_t BinaryGcd(uint64_t a, uint64_t b)
+{
+	while ( (a | b) >> 63 )  // Euclid steps until the signed difference works
+	{
+		if ( b == 0 )  return a;
+		a %= b;
+		swap(a, b);
+	}
+	if ( a == 0 )  return b;
+	if ( b == 0 )  return a;
+	int az = countr_zero(a);
+	const int shift = min(az, countr_zero(b));
+	b >>= countr_zero(b);
+	while ( a )
+	{
+		a >>= az;
+		const int64_t diff = static_cast<int64_t>(b - a);
+		az = countr_zero(static_cast<uint64_t>(diff));
+		b = min(a, b);
+		a = Magnitude(diff);
+	}
+	return b << shift;
+}
+
+
+
+// Euclid steps on 128 bits while either value needs them, then BinaryGcd.
+// Only results of operations that do not fit into 64 bits get here.
+uint128 Gcd(uint128 a, uint128 b)
+{
+	while ( (a | b) >> 64 )
+	{
+		if ( b == 0 )  return a;
+		a %= b;
+		swap(a, b);
+	}
+	return BinaryGcd(static_cast<uint64_t>(a), static_cast<uint64_t>(b));
+}
+
+
+
+enum class Reduction { eager, lazy };
+
+// p_/q_ with q_ > 0 and |p_| <= INT64_MAX, so that negation never overflows.
+// A product of two fields fits into 127 bits and a sum of two products into
+// 128 bits, so every operation is exact before the final range check.
+// In the eager mode p_/q_ is always reduced, as in operator_overload.cpp.
+// In the lazy mode it is reduced only when the exact result does not fit
+// into 64 bits; comparisons do not need reduced values (they cross-multiply
+// in 128 bits), and output prints the reduced form.
+template <Reduction mode>
+class Rational
+{
+public:
+	Rational(int64_t p = 0, int64_t q = 1);
+	int64_t Num() const { return p_; }
+	int64_t Den() const { return q_; }
+	const Rational& Normalize();
+	const Rational& operator +=(const Rational& other);
+	const Rational& operator -=(const Rational& other);
+	const Rational& operator *=(const Rational& other);
+	const Rational& operator /=(const Rational& other);
+
+private:
+	int64_t p_;
+	int64_t q_;
+	void Assign(int128 p, int128 q);
+
+	friend bool operator ==(const Rational& lhs, const Rational& rhs)
+	{
+		if constexpr ( mode == Reduction::eager )  return lhs.p_ == rhs.p_ && lhs.q_ == rhs.q_;
+		return static_cast<int128>(lhs.p_) * rhs.q_ == static_cast<int128>(rhs.p_) * lhs.q_;
+	}
+	friend bool operator <(const Rational& lhs, const Rational& rhs)  // For sets and maps
+	{
+		return static_cast<int128>(lhs.p_) * rhs.q_ < static_cast<int128>(rhs.p_) * lhs.q_;
+	}
+	friend const Rational operator +(Rational lhs, const Rational& rhs) { return lhs += rhs; }
+	friend const Rational operator -(Rational lhs, const Rational& rhs) { return lhs -= rhs; }
+	friend const Rational operator *(Rational lhs, const Rational& rhs) { return lhs *= rhs; }
+	friend const Rational operator /(Rational lhs, const Rational& rhs) { return lhs /= rhs; }
+	friend ostream& operator <<(ostream& os, Rational r)
+	{
+		r.Normalize();
+		return os << r.p_ << '/' << r.q_;
+	}
+};
+
+using EagerRational = Rational<Reduction::eager>;
+using LazyRational = Rational<Reduction::lazy>;
+
+
+
+template <Reduction mode>
+Rational<mode>::Rational(int64_t p, int64_t q)
+{
+	if ( q == 0 )  throw invalid_argument("Rational: zero denominator");
+	if ( q < 0 )  Assign(-static_cast<int128>(p), -static_cast<int128>(q));
+	else  Assign(p, q);
+}
+
+
+
+// Reduces by the gcd: 64-bit if the exact result fits into 64 bits (which
+// the lazy mode then stores as is), 128-bit otherwise.
+template <Reduction mode>
+void Rational<mode>::Assign(int128 p, int128 q)
+{
+	if ( Fits(p) && Fits(q) )
+	{
+		p_ = static_cast<int64_t>(p);
+		q_ = static_cast<int64_t>(q);
+		if constexpr ( mode == Reduction::eager )  Normalize();
+		return;
+	}
+	const int128 g = Gcd(p < 0 ? -p : p, q);
+	p /= g;
+	q /= g;
+	if ( !Fits(p) || !Fits(q) )  throw overflow_error("Rational: result does not fit into 64 bits");
+	p_ = static_cast<int64_t>(p);
+	q_ = static_cast<int64_t>(q);
+}
+
+
+
+template <Reduction mode>
+const Rational<mode>& Rational<mode>::Normalize()
+{
+	const int64_t g = BinaryGcd(Magnitude(p_), q_);  // q_ if p_ == 0, so 0 becomes 0/1
+	p_ /= g;
+	q_ /= g;
+	return *this;
+}
+
+
+
+// Values with a common denominator (such as prices in cents) are added
+// without multiplications, and in the lazy mode without any gcd.
+template <Reduction mode>
+const Rational<mode>& Rational<mode>::operator +=(const Rational& other)
+{
+	if ( q_ == other.q_ )  Assign(static_cast<int128>(p_) + other.p_, q_);
+	else  Assign(static_cast<int128>(p_) * other.q_ + static_cast<int128>(other.p_) * q_,
+	             static_cast<int128>(q_) * other.q_);
+	return *this;
+}
+
+
+
+template <Reduction mode>
+const Rational<mode>& Rational<mode>::operator -=(const Rational& other)
+{
+	if ( q_ == other.q_ )  Assign(static_cast<int128>(p_) - other.p_, q_);
+	else  Assign(static_cast<int128>(p_) * other.q_ - static_cast<int128>(other.p_) * q_,
+	             static_cast<int128>(q_) * other.q_);
+	return *this;
+}
+
+
+
+template <Reduction mode>
+const Rational<mode>& Rational<mode>::operator *=(const Rational& other)
+{
+	Assign(static_cast<int128>(p_) * other.p_, static_cast<int128>(q_) * other.q_);
+	return *this;
+}
+
+
+
+template <Reduction mode>
+const Rational<mode>& Rational<mode>::operator /=(const Rational& other)
+{
+	if ( other.p_ == 0 )  throw domain_error("Rational: division by zero");
+	const int128 p = static_cast<int128>(p_) * other.q_;
+	const int128 q = static_cast<int128>(q_) * other.p_;
+	if ( q < 0 )  Assign(-p, -q);
+	else  Assign(p, q);
+	return *this;
+}
+
+
+
+template <Reduction mode>
+istream& operator >>(istream& is, Rational<mode>& r)
+{
+	int64_t n, d;
+	char ch;
+	if ( is )
+	{
+		is >> n >> ch >> d;
+		if ( is )
+		{
+			if ( ch == '/' && d != 0 )  r = Rational<mode>(n, d);
+			else  is.setstate(ios_base::failbit);
+		}
+	}
+	return is;
+}
+
+
+
+//-----------------------------------------------------------------------------
+
+
+// Rationals as separate arrays of numerators and denominators, so that the
+// batch operations below work on whole SIMD vectors. Elements may be stored
+// unreduced and with any signs, but not with a zero denominator; Normalize()
+// brings them to the form of Rational.
+class RationalArray
+{
+public:
+	RationalArray() = default;
+	explicit RationalArray(size_t size) : p_(size), q_(size, 1) {}
+	template <Reduction mode>
+	explicit RationalArray(span<const Rational<mode>> values);
+
+	size_t size() const { return p_.size(); }
+	EagerRational operator [](size_t i) const { return {p_[i], q_[i]}; }
+	void Set(size_t i, int64_t p, int64_t q);
+	span<int64_t> Num() { return p_; }
+	span<int64_t> Den() { return q_; }
+	span<const int64_t> Num() const { return p_; }
+	span<const int64_t> Den() const { return q_; }
+
+private:
+	vector<int64_t> p_;
+	vector<int64_t> q_;
+};
+
+
+
+template <Reduction mode>
+RationalArray::RationalArray(span<const Rational<mode>> values) : RationalArray(values.size())
+{
+	for ( size_t i = 0; i < size(); ++i )
+	{
+		p_[i] = values[i].Num();
+		q_[i] = values[i].Den();
+	}
+}
+
+
+
+void RationalArray::Set(size_t i, int64_t p, int64_t q)
+{
+	if ( q == 0 )  throw invalid_argument("RationalArray: zero denominator");
+	p_[i] = p;
+	q_[i] = q;
+}
+
+
+
+template <typename... Sizes>
+void CheckSizes(size_t size, Sizes... sizes)
+{
+	if ( ((sizes != size) || ...) )  throw invalid_argument("RationalArray: sizes do not match");
+}
+
+
+
+// GCC/Clang vector extension. Plain loops over lanes of the binary gcd do
+// not vectorize with GCC, because every lane needs a different number of
+// steps; here all lanes step until the last one is done. The vectors are
+// as wide as the registers of the target: a wider one returned by value
+// would be passed in memory, and GCC warns that this changes the ABI.
+#if defined(__AVX512F__)
+constexpr size_t vector_bytes = 64;
+#elif defined(__AVX__)
+constexpr size_t vector_bytes = 32;
+#else
+constexpr size_t vector_bytes = 16;
+#endif
+using Lanes = uint64_t __attribute__((vector_size(vector_bytes)));
+using SignedLanes = int64_t __attribute__((vector_size(vector_bytes)));
+using DoubleLanes = double __attribute__((vector_size(vector_bytes)));
+
+constexpr size_t lanes = sizeof(Lanes) / sizeof(uint64_t);
+constexpr size_t lane_groups = 4;  // Independent vectors hide the latency of a step
+constexpr size_t batch = lanes * lane_groups;  // Rationals per kernel call
+
+// There is no vector count of trailing zeros, but the lowest set bit
+// converted to double has its position in the exponent. Valid for x != 0.
+inline Lanes Ctz(Lanes x)
+{
+	const DoubleLanes low = __builtin_convertvector(x & -x, DoubleLanes);
+	return (reinterpret_cast<Lanes>(low) >> 52) - 1023;
+}
+
+
+
+// Reduces batch rationals with nonzero denominators and |p|, |q| < 2^63 in
+// place: sign into the numerator, then Stein's algorithm in all lanes with
+// selects instead of branches. The division by the gcd is exact, so it is a
+// shift by its power of two and a multiplication by the inverse of its odd
+// part modulo 2^64, which Newton's iteration finds in four steps.
+void NormalizeBatch(int64_t* num, int64_t* den)
+{
+	SignedLanes p[lane_groups], q[lane_groups];
+	Lanes a[lane_groups], b[lane_groups], shift[lane_groups];
+	memcpy(p, num, sizeof(p));
+	memcpy(q, den, sizeof(q));
+	Lanes active {};
+	for ( size_t k = 0; k < lane_groups; ++k )
+	{
+		const SignedLanes s = q[k] >> 63;
+		p[k] = (p[k] ^ s) - s;
+		q[k] = (q[k] ^ s) - s;
+		const SignedLanes m = p[k] >> 63;
+		a[k] = reinterpret_cast<Lanes>(q[k]);
+		b[k] = reinterpret_cast<Lanes>((p[k] ^ m) - m);
+		shift[k] = Ctz(a[k] | b[k]);
+		a[k] >>= Ctz(a[k]);
+		active |= b[k];
+	}
+	const Lanes top = Lanes {} + (uint64_t {1} << 63);  // Makes Ctz(0) 63
+	for ( ; ; )
+	{
+		uint64_t any = 0;
+		for ( size_t i = 0; i < lanes; ++i )  any |= active[i];
+		if ( !any )  break;
+		active = Lanes {};
+		for ( size_t k = 0; k < lane_groups; ++k )  // a is odd, b even or 0
+		{
+			const Lanes y = b[k] >> Ctz(b[k] | top);
+			const Lanes lo = y < a[k] ? y : a[k], hi = y < a[k] ? a[k] : y;
+			a[k] = y == 0 ? a[k] : lo;
+			b[k] = y == 0 ? y : hi - lo;
+			active |= b[k];
+		}
+	}
+	for ( size_t k = 0; k < lane_groups; ++k )
+	{
+		Lanes inv = (3 * a[k]) ^ 2;  // 5 correct bits
+		for ( int i = 0; i < 4; ++i )  inv *= 2 - a[k] * inv;
+		const SignedLanes sp = p[k] >> reinterpret_cast<SignedLanes>(shift[k]);
+		p[k] = reinterpret_cast<SignedLanes>(reinterpret_cast<Lanes>(sp) * inv);
+		q[k] = reinterpret_cast<SignedLanes>((reinterpret_cast<Lanes>(q[k]) >> shift[k]) * inv);
+	}
+	memcpy(num, p, sizeof(p));
+	memcpy(den, q, sizeof(q));
+}
+
+
+
+// Throws invalid_argument for a zero denominator and overflow_error for a
+// field equal to INT64_MIN, before anything is changed.
+void Normalize(RationalArray& r)
+{
+	const auto p = r.Num(), q = r.Den();
+	uint64_t bad = 0, min = 0;
+	for ( size_t i = 0; i < r.size(); ++i )
+	{
+		bad |= q[i] == 0;
+		min |= (p[i] == numeric_limits<int64_t>::min()) | (q[i] == numeric_limits<int64_t>::min());
+	}
+	if ( bad )  throw invalid_argument("RationalArray: zero denominator");
+	if ( min )  throw overflow_error("RationalArray: INT64_MIN does not fit into Rational");
+	size_t i = 0;
+	for ( ; i + batch <= r.size(); i += batch )  NormalizeBatch(&p[i], &q[i]);
+	if ( i == r.size() )  return;
+	int64_t tp[batch] {}, tq[batch];
+	fill(begin(tq), end(tq), 1);
+	copy(p.begin() + i, p.end(), tp);
+	copy(q.begin() + i, q.end(), tq);
+	NormalizeBatch(tp, tq);
+	copy(tp, tp + (r.size() - i), p.begin() + i);
+	copy(tq, tq + (r.size() - i), q.begin() + i);
+}
+
+
+
+// Batch operations compute a block of results in wrapping 64-bit unsigned
+// arithmetic, which is exact when the fields of both arguments are below
+// 2^31 in magnitude (and denominators are not 0). Blocks with elements
+// outside this range are redone with Rational, so they are exact as well,
+// or throw. The inputs are read before a block is written, so 'out' may be
+// one of the arguments.
+inline bool IsNarrow(int64_t p, int64_t q)
+{
+	return ((Magnitude(p) | (Magnitude(q) - 1)) >> 31) == 0;
+}
+
+template <typename Narrow, typename Wide>
+void ForBlocks(size_t size, span<int64_t> num, span<int64_t> den, Narrow narrow, Wide wide)
+{
+	for ( size_t i = 0; i < size; i += batch )
+	{
+		const size_t n = min(batch, size - i);
+		int64_t p[batch], q[batch];
+		if ( narrow(i, n, p, q) )
+		{
+			fill(p + n, p + batch, 0);
+			fill(q + n, q + batch, 1);
+			NormalizeBatch(p, q);
+		}
+		else
+		{
+			for ( size_t k = 0; k < n; ++k )
+			{
+				const EagerRational r = wide(i + k);
+				p[k] = r.Num();
+				q[k] = r.Den();
+			}
+		}
+		copy(p, p + n, num.begin() + i);
+		copy(q, q + n, den.begin() + i);
+	}
+}
+
+
+
+void Add(const RationalArray& a, const RationalArray& b, RationalArray& out)
+{
+	CheckSizes(a.size(), b.size(), out.size());
+	const int64_t* pa = a.Num().data();
+	const int64_t* qa = a.Den().data();
+	const int64_t* pb = b.Num().data();
+	const int64_t* qb = b.Den().data();
+	auto narrow = [=](size_t i, size_t n, int64_t* p, int64_t* q)
+	{
+		bool ok = true;
+		for ( size_t k = i; k < i + n; ++k )
+		{
+			ok &= IsNarrow(pa[k], qa[k]) & IsNarrow(pb[k], qb[k]);
+			p[k - i] = static_cast<uint64_t>(pa[k]) * qb[k] + static_cast<uint64_t>(pb[k]) * qa[k];
+			q[k - i] = static_cast<uint64_t>(qa[k]) * qb[k];
+		}
+		return ok;
+	};
+	ForBlocks(a.size(), out.Num(), out.Den(), narrow, [&](size_t k) { return a[k] + b[k]; });
+}
+
+
+
+void Multiply(const RationalArray& a, const RationalArray& b, RationalArray& out)
+{
+	CheckSizes(a.size(), b.size(), out.size());
+	const int64_t* pa = a.Num().data();
+	const int64_t* qa = a.Den().data();
+	const int64_t* pb = b.Num().data();
+	const int64_t* qb = b.Den().data();
+	auto narrow = [=](size_t i, size_t n, int64_t* p, int64_t* q)
+	{
+		bool ok = true;
+		for ( size_t k = i; k < i + n; ++k )
+		{
+			ok &= IsNarrow(pa[k], qa[k]) & IsNarrow(pb[k], qb[k]);
+			p[k - i] = static_cast<uint64_t>(pa[k]) * pb[k];
+			q[k - i] = static_cast<uint64_t>(qa[k]) * qb[k];
+		}
+		return ok;
+	};
+	ForBlocks(a.size(), out.Num(), out.Den(), narrow, [&](size_t k) { return a[k] * b[k]; });
+}
+
+
+
+// out[i] = -1, 0 or 1 as a[i] is less than, equal to or greater than b[i].
+// The sign of pa qb - pb qa is flipped for every negative denominator. The
+// main loop works on whole vectors of the gcd kernel: as a plain loop it is
+// vectorized at -O3 only, after a check that 'out' overlaps no input.
+void Compare(const RationalArray& a, const RationalArray& b, span<int8_t> out)
+{
+	CheckSizes(a.size(), b.size(), out.size());
+	const int64_t* pa = a.Num().data();
+	const int64_t* qa = a.Den().data();
+	const int64_t* pb = b.Num().data();
+	const int64_t* qb = b.Den().data();
+	auto magnitude = [](Lanes x)  // As Magnitude()
+	{
+		const Lanes sign = reinterpret_cast<Lanes>(reinterpret_cast<SignedLanes>(x) >> 63);
+		return (x ^ sign) - sign;
+	};
+	Lanes fields {};  // The bits of all |p| and |q| - 1, as in IsNarrow()
+	size_t i = 0;
+	for ( ; i + lanes <= out.size(); i += lanes )
+	{
+		Lanes x, y, u, v;  // x/y and u/v
+		memcpy(&x, pa + i, sizeof(x));
+		memcpy(&y, qa + i, sizeof(y));
+		memcpy(&u, pb + i, sizeof(u));
+		memcpy(&v, qb + i, sizeof(v));
+		fields |= magnitude(x) | (magnitude(y) - 1) | magnitude(u) | (magnitude(v) - 1);
+		const SignedLanes d = reinterpret_cast<SignedLanes>(x * v - u * y);
+		const SignedLanes flip = reinterpret_cast<SignedLanes>(y ^ v) >> 63;  // 0 or -1
+		const SignedLanes sign = (d < 0) - (d > 0);  // A true comparison is -1
+		const SignedLanes r = (sign ^ flip) - flip;
+		for ( size_t l = 0; l < lanes; ++l )  out[i + l] = static_cast<int8_t>(r[l]);
+	}
+	uint64_t wide = 0;
+	for ( size_t l = 0; l < lanes; ++l )  wide |= fields[l];
+	for ( ; i < out.size(); ++i )
+	{
+		wide |= Magnitude(pa[i]) | (Magnitude(qa[i]) - 1) | Magnitude(pb[i]) | (Magnitude(qb[i]) - 1);
+		const int64_t d = static_cast<uint64_t>(pa[i]) * qb[i] - static_cast<uint64_t>(pb[i]) * qa[i];
+		const int8_t sign = (d > 0) - (d < 0);
+		out[i] = (qa[i] ^ qb[i]) < 0 ? -sign : sign;
+	}
+	if ( (wide >> 31) == 0 )  return;
+	for ( size_t i = 0; i < out.size(); ++i )
+	{
+		if ( IsNarrow(pa[i], qa[i]) && IsNarrow(pb[i], qb[i]) )  continue;
+		const EagerRational x = a[i], y = b[i];
+		out[i] = (y < x) - (x < y);
+	}
+}
+
+
+
+//-----------------------------------------------------------------------------
+
+
+// The multiply-xorshift steps of HashWord() in word_processing.cpp over the
+// reduced fields, which are the canonical form of a value
+inline uint64_t HashRational(int64_t p, int64_t q)
+{
+	uint64_t h = (static_cast<uint64_t>(q) * 0x9e3779b97f4a7c15 ^ p) * 0xbf58476d1ce4e5b9;
+	h = (h ^ (h >> 31)) * 0x94d049bb133111eb;
+	return h ^ (h >> 32);
+}
+
+
+
+// Equal values hash equally in both modes: a lazy value is reduced on a copy
+template <Reduction mode>
+struct std::hash<Rational<mode>>
+{
+	size_t operator ()(Rational<mode> r) const
+	{
+		if constexpr ( mode == Reduction::lazy )  r.Normalize();
+		return HashRational(r.Num(), r.Den());
+	}
+};
+
+
+
+// Open addressing with linear probing, as StringInterner of
+// word_processing.cpp. Keys are reduced, so a probe compares two integers
+// and needs no multiplication, and the slots of a small table stay in cache
+// where map<> chases a pointer per level.
+template <typename V>
+class RationalTable
+{
+public:
+	RationalTable() : slots_(1024) {}
+
+	V& operator [](const EagerRational& key);
+	const V* Find(const EagerRational& key) const;  // nullptr if absent
+	size_t size() const { return size_; }
+	template <typename OutputIt> OutputIt Copy(OutputIt out) const;  // Key-value pairs, unordered
+
+private:
+	struct Slot
+	{
+		EagerRational key;
+		V value {};
+		bool used = false;
+	};
+	vector<Slot> slots_;  // Size is a power of two, at most 70% used
+	size_t size_ = 0;
+
+	size_t Probe(const EagerRational& key) const;  // The slot of key or the empty one to take
+	void Grow();
+};
+
+
+
+template <typename V>
+size_t RationalTable<V>::Probe(const EagerRational& key) const
+{
+	const size_t mask = slots_.size() - 1;
+	for ( size_t i = HashRational(key.Num(), key.Den()) & mask; ; i = (i + 1) & mask )
+	{
+		const Slot& slot = slots_[i];
+		if ( !slot.used || slot.key == key )  return i;
+	}
+}
+
+
+
+template <typename V>
+V& RationalTable<V>::operator [](const EagerRational& key)
+{
+	size_t i = Probe(key);
+	if ( slots_[i].used )  return slots_[i].value;
+	if ( (size_ + 1) * 10 > slots_.size() * 7 )
+	{
+		Grow();
+		i = Probe(key);
+	}
+	slots_[i] = {key, V {}, true};
+	++size_;
+	return slots_[i].value;
+}
+
+
+
+template <typename V>
+const V* RationalTable<V>::Find(const EagerRational& key) const
+{
+	const Slot& slot = slots_[Probe(key)];
+	return slot.used ? &slot.value : nullptr;
+}
+
+
+
+template <typename V>
+template <typename OutputIt>
+OutputIt RationalTable<V>::Copy(OutputIt out) const
+{
+	for ( const Slot& slot : slots_ )
+		if ( slot.used )  *out++ = pair(slot.key, slot.value);
+	return out;
+}
+
+
+
+template <typename V>
+void RationalTable<V>::Grow()
+{
+	vector<Slot> slots(2 * slots_.size());
+	swap(slots, slots_);
+	for ( Slot& slot : slots )
+		if ( slot.used )  slots_[Probe(slot.key)] = move(slot);
+}
+
+
+
+inline double OrderKey(const EagerRational& r)
+{
+	return static_cast<double>(r.Num()) / static_cast<double>(r.Den());
+}
+
+
+
+// Sorted keys in a flat array, for a map that is mostly looked up: the
+// binary search reads only the double keys, 8 per cache line, instead of
+// following tree nodes. Insertion shifts the tail, as in any flat map.
+template <typename V>
+class RationalFlatMap
+{
+public:
+	V& operator [](const EagerRational& key);
+	const V* Find(const EagerRational& key) const;  // nullptr if absent
+	size_t size() const { return keys_.size(); }
+	template <typename OutputIt> OutputIt Copy(OutputIt out) const;  // Key-value pairs, ascending
+
+private:
+	vector<double> keys_;  // OrderKey() of rationals_
+	vector<EagerRational> rationals_;
+	vector<V> values_;
+
+	size_t LowerBound(double key, const EagerRational& r) const;
+};
+
+
+
+// Each of fl(p), fl(q) and their quotient is rounded once, so the double
+// key of p/q is within 3 * 2^-53 of it relatively. A stored key farther
+// than 2^-48 * |key| from key orders its value the same way, and only keys
+// inside that band (equal values among them) need the exact 128-bit
+// comparison.
+// The search is branch-free otherwise: the span halves whatever the
+// comparison gives and only its start moves, so random keys do not
+// mispredict.
+template <typename V>
+size_t RationalFlatMap<V>::LowerBound(double key, const EagerRational& r) const
+{
+	const double band = 0x1p-48 * abs(key);
+	auto less = [&](size_t i)
+	{
+		if ( abs(keys_[i] - key) <= band ) [[unlikely]]  return rationals_[i] < r;
+		return keys_[i] < key;
+	};
+	size_t first = 0, count = keys_.size();
+	if ( count == 0 )  return 0;
+	while ( count > 1 )
+	{
+		const size_t half = count / 2;
+		first += half * less(first + half - 1);
+		count -= half;
+	}
+	return first + less(first);
+}
+
+
+
+template <typename V>
+V& RationalFlatMap<V>::operator [](const EagerRational& key)
+{
+	const double k = OrderKey(key);
+	const size_t i = LowerBound(k, key);
+	if ( i < size() && rationals_[i] == key )  return values_[i];
+	keys_.insert(keys_.begin() + i, k);
+	rationals_.insert(rationals_.begin() + i, key);
+	return *values_.insert(values_.begin() + i, V {});
+}
+
+
+
+template <typename V>
+const V* RationalFlatMap<V>::Find(const EagerRational& key) const
+{
+	const size_t i = LowerBound(OrderKey(key), key);
+	return (i < size() && rationals_[i] == key) ? &values_[i] : nullptr;
+}
+
+
+
+template <typename V>
+template <typename OutputIt>
+OutputIt RationalFlatMap<V>::Copy(OutputIt out) const
+{
+	for ( size_t i = 0; i < size(); ++i )  *out++ = pair(rationals_[i], values_[i]);
+	return out;
+}
+
+
+
+//-----------------------------------------------------------------------------
+
+
+// Text conversions over buffers, in the manner of from_chars and to_chars:
+// no locale, no exceptions and no stream state. Rationals are written as
+// p/q, as operator<< writes them, and read with the rules of operator>>
+// except for spaces: leading whitespace is skipped, each integer may have a
+// sign, and a value without "/q" is an integer. "3 / 4" is not one value.
+// An error gives errc::invalid_argument for text that is not a rational or
+// has a zero denominator, errc::result_out_of_range for a value that does
+// not fit, and ptr where the error was found.
+
+constexpr size_t rational_chars = 40;  // Longest p/q: -9223372036854775807/9223372036854775807
+
+inline bool IsSpace(char c)  // As isspace() in the "C" locale
+{
+	return c == ' ' || static_cast<uint8_t>(c - '\t') < 5;
+}
+
+inline const char* SkipSpace(const char* first, const char* last)
+{
+	while ( first != last && IsSpace(*first) )  ++first;
+	return first;
+}
+
+
+
+// from_chars() takes no '+', and "+-1" must not pass for -1
+inline from_chars_result ParseInteger(const char* first, const char* last, int64_t& value)
+{
+	if ( last - first > 1 && *first == '+' && static_cast<uint8_t>(first[1] - '0') < 10 )  ++first;
+	const from_chars_result r = from_chars(first, last, value);
+	if ( r.ec == errc::invalid_argument )  return {first, r.ec};
+	return r;
+}
+
+
+
+template <Reduction mode>
+from_chars_result FromChars(const char* first, const char* last, Rational<mode>& r)
+{
+	first = SkipSpace(first, last);
+	int64_t n, d = 1;
+	from_chars_result res = ParseInteger(first, last, n);
+	if ( res.ec != errc() )  return res;
+	const char* den = res.ptr;
+	if ( res.ptr != last && *res.ptr == '/' )
+	{
+		res = ParseInteger(++den, last, d);
+		if ( res.ec != errc() )  return res;
+		if ( d == 0 )  return {den, errc::invalid_argument};
+	}
+	int128 p = n, q = d;
+	if ( q < 0 ) { p = -p; q = -q; }
+	if ( !Fits(p) || !Fits(q) )  // INT64_MIN, fits only if it reduces
+	{
+		const int128 g = Gcd(p < 0 ? -p : p, q);
+		p /= g;
+		q /= g;
+		if ( !Fits(p) || !Fits(q) )  return {first, errc::result_out_of_range};
+	}
+	r = Rational<mode>(static_cast<int64_t>(p), static_cast<int64_t>(q));
+	return res;
+}
+
+
+
+// Writes the reduced p/q; rational_chars of space always suffice
+template <Reduction mode>
+to_chars_result ToChars(char* first, char* last, Rational<mode> r)
+{
+	if constexpr ( mode == Reduction::lazy )  r.Normalize();
+	const to_chars_result res = to_chars(first, last, r.Num());
+	if ( res.ec != errc() )  return res;
+	if ( res.ptr == last )  return {last, errc::value_too_large};
+	*res.ptr = '/';
+	return to_chars(res.ptr + 1, last, r.Den());
+}
+
+
+
+struct ParseResult
+{
+	size_t count;     // Values stored
+	const char* ptr;  // Where parsing stopped: the end, the next value or the error
+	errc ec;
+};
+
+// Whitespace-separated values into out, until the end of text, an error or
+// a full out (then ptr is where to continue with the next span)
+template <Reduction mode>
+ParseResult ParseRationals(string_view text, span<Rational<mode>> out)
+{
+	const char* p = text.data();
+	const char* last = p + text.size();
+	size_t count = 0;
+	for ( ; ; ++count )
+	{
+		p = SkipSpace(p, last);
+		if ( p == last || count == out.size() )  return {count, p, errc()};
+		const from_chars_result r = FromChars(p, last, out[count]);
+		if ( r.ec != errc() )  return {count, r.ptr, r.ec};
+		if ( r.ptr != last && !IsSpace(*r.ptr) )  return {count, r.ptr, errc::invalid_argument};
+		p = r.ptr;
+	}
+}
+
+
+
+// One value per line
+template <Reduction mode>
+string FormatRationals(span<const Rational<mode>> values)
+{
+	string text(values.size() * (rational_chars + 1), '\0');
+	char* p = text.data();
+	for ( const Rational<mode>& r : values )
+	{
+		p = ToChars(p, p + rational_chars, r).ptr;
+		*p++ = '\n';
+	}
+	text.resize(p - text.data());
+	return text;
+}
+
+
+
+//-----------------------------------------------------------------------------
+
+
+template <typename F>
+double TimeSec(F f)
+{
+	const auto t = chrono::steady_clock::now();
+	f();
+	return chrono::duration<double>(chrono::steady_clock::now() - t).count();
+}
+
+
+
+template <typename R>
+string ToString(const R& r)
+{
+	ostringstream os;
+	os << r;
+	return os.str();
+}
+
+
+
+template <Reduction mode>
+void Demo(const char* name)
+{
+	using R = Rational<mode>;
+	R r1(3, 10), r2(1, 10);
+	cout << name << ": " << r1 + r2 << ' ' << r1 - r2 << ' ' << r1 * r2 << ' ' << r1 / r2 << '\n';
+	assert( r1 + r2 == R(2, 5) );
+	assert( r1 - r2 == R(1, 5) );
+	assert( r1 * r2 == R(3, 100) );
+	assert( r1 / r2 == R(3, 1) );
+
+	const set<R> rs = {{1, 2}, {2, 4}, {50, 100}, {1500, 3000}};
+	assert( rs.size() == 1 );
+	map<R, int> m;
+	++m[{1, 3}];
+	++m[{2, 5}];
+	++m[{3, 9}];
+	++m[{10, 25}];
+	assert( m == (map<R, int> { {{1, 3}, 2}, {{2, 5}, 2} }) );
+}
+
+
+
+// Harmonic numbers 1 + 1/2 + ... + 1/n: the int version goes wrong silently,
+// the 64-bit one throws when a result does not fit.
+void OverflowDemo()
+{
+	IntRational h_int(0, 1);
+	EagerRational h;
+	int wrong = 0;
+	for ( int n = 1; ; ++n )
+	{
+		h_int += IntRational(1, n);
+		try { h += EagerRational(1, n); }
+		catch ( const overflow_error& e )
+		{
+			cout << "H(" << n << "): " << e.what() << '\n';
+			break;
+		}
+		if ( !wrong && ToString(h_int) != ToString(h) )
+		{
+			wrong = n;
+			cout << "H(" << n << ") = " << h << ", IntRational gives " << h_int << '\n';
+		}
+	}
+}
+
+
+
+// Sums of 'chain' consecutive terms, as in totals of prices
+template <typename R>
+vector<R> ChainSums(const vector<R>& terms, size_t chain)
+{
+	vector<R> sums;
+	for ( size_t i = 0; i + chain <= terms.size(); i += chain )
+	{
+		R sum(0, 1);
+		for ( size_t k = i; k < i + chain; ++k )  sum += terms[k];
+		sums.push_back(sum);
+	}
+	return sums;
+}
+
+
+
+void ChainBenchmark(const char* name, const vector<pair<int, int>>& terms, size_t chain)
+{
+	vector<IntRational> t_int;
+	vector<EagerRational> t_eager;
+	vector<LazyRational> t_lazy;
+	for ( auto [p, q] : terms )
+	{
+		t_int.emplace_back(p, q);
+		t_eager.emplace_back(p, q);
+		t_lazy.emplace_back(p, q);
+	}
+	vector<IntRational> s_int;
+	vector<EagerRational> s_eager;
+	vector<LazyRational> s_lazy;
+	const double sec[] = {
+		TimeSec([&]{ s_int = ChainSums(t_int, chain); }),
+		TimeSec([&]{ s_eager = ChainSums(t_eager, chain); }),
+		TimeSec([&]{ s_lazy = ChainSums(t_lazy, chain); }) };
+	size_t differ = 0;
+	for ( size_t i = 0; i < s_int.size(); ++i )
+	{
+		const string s = ToString(s_eager[i]);
+		differ += s != ToString(s_int[i]) || s != ToString(s_lazy[i]);
+	}
+	cout << setw(26) << left << name << right;
+	for ( double s : sec )  cout << setw(7) << s * 1e9 / terms.size() << " ns";
+	cout << "   (" << differ << " of " << s_int.size() << " sums differ)\n";
+}
+
+
+
+void ChainBenchmark()
+{
+	const size_t count = 4'000'000, chain = 256;
+	mt19937 gen(1);
+	uniform_int_distribution<int> cents(1, 999);
+	vector<pair<int, int>> terms(count);
+	for ( auto& t : terms )  t = {cents(gen), 100};
+	cout << "Sums of " << chain << " terms, per addition:  IntRational, eager, lazy\n";
+	ChainBenchmark("prices p/100", terms, chain);
+
+	const int dens[] = {2, 3, 4, 5, 6, 8, 10, 12, 20, 24, 25, 50, 100};  // lcm 600
+	uniform_int_distribution<int> num(1, 99), den(0, size(dens) - 1);
+	for ( auto& t : terms )  t = {num(gen), dens[den(gen)]};
+	ChainBenchmark("mixed denominators", terms, chain);
+}
+
+
+
+void BatchDemo()
+{
+	RationalArray r(4);
+	r.Set(0, 6, -4);
+	r.Set(1, 0, 5);
+	r.Set(2, -10, -25);
+	r.Set(3, 1 << 20, 3 << 10);
+	Normalize(r);
+	cout << "Normalize:";
+	for ( size_t i = 0; i < r.size(); ++i )  cout << ' ' << r.Num()[i] << '/' << r.Den()[i];
+	RationalArray sum(r.size());
+	Add(r, r, sum);
+	cout << ", doubled:";
+	for ( size_t i = 0; i < sum.size(); ++i )  cout << ' ' << sum[i];
+	cout << '\n';
+}
+
+
+
+void Report(const char* name, size_t count, double sec)
+{
+	cout << setw(26) << left << name << right << setw(7) << count / sec / 1e6 << " M/s\n";
+}
+
+
+
+template <typename F>
+double ReduceScalar(RationalArray& r, F gcd_function)
+{
+	const auto p = r.Num(), q = r.Den();
+	return TimeSec([&]{
+		for ( size_t i = 0; i < r.size(); ++i )
+		{
+			if ( q[i] < 0 ) { p[i] = -p[i]; q[i] = -q[i]; }
+			const int64_t g = gcd_function(p[i], q[i]);
+			p[i] /= g;
+			q[i] /= g;
+		}
+	});
+}
+
+
+
+// Random fractions with a common factor, |p| and q below 2^31 (for Euclid)
+void GcdBenchmark()
+{
+	const size_t count = 4'000'000;
+	mt19937_64 gen(2);
+	RationalArray raw(count);
+	for ( size_t i = 0; i < count; ++i )
+	{
+		const int64_t k = 1 + gen() % 32;
+		const int64_t p = (1 + gen() % (1 << 26)) * k, q = (1 + gen() % (1 << 26)) * k;
+		raw.Set(i, gen() & 1 ? p : -p, gen() & 1 ? q : -q);
+	}
+	RationalArray r[4] = {raw, raw, raw, raw};
+	const double sec[] = {
+		ReduceScalar(r[0], [](int64_t p, int64_t q) { return Euclid(p, q); }),
+		ReduceScalar(r[1], [](int64_t p, int64_t q) { return gcd(p, q); }),
+		ReduceScalar(r[2], [](int64_t p, int64_t q) { return BinaryGcd(Magnitude(p), q); }),
+		TimeSec([&]{ Normalize(r[3]); }) };
+	const char* names[] = {"Euclid (int)", "std::gcd", "BinaryGcd", "Normalize (SIMD batches)"};
+	cout << "Reduction of p/q:\n";
+	for ( size_t i = 0; i < size(sec); ++i )
+	{
+		const bool same = ranges::equal(r[i].Num(), r[0].Num()) && ranges::equal(r[i].Den(), r[0].Den());
+		Report(names[i], count, sec[i]);
+		if ( !same )  cout << "  results differ\n";
+	}
+}
+
+
+
+template <typename Batched, typename Scalar>
+void BatchBenchmark(const char* name, size_t count, Batched batched, Scalar scalar)
+{
+	const double sec[] = {TimeSec(scalar), TimeSec(batched)};
+	cout << setw(10) << left << name << right << " Rational " << setw(7) << count / sec[0] / 1e6
+	     << " M/s, RationalArray " << setw(7) << count / sec[1] / 1e6 << " M/s\n";
+}
+
+
+
+void BatchBenchmark()
+{
+	const size_t count = 4'000'000;
+	mt19937_64 gen(3);
+	uniform_int_distribution<int64_t> num(-1'000'000, 1'000'000), den(1, 1'000'000);
+	vector<EagerRational> a(count), b(count), c(count);
+	for ( size_t i = 0; i < count; ++i )
+	{
+		a[i] = {num(gen), den(gen)};
+		b[i] = {num(gen), den(gen)};
+	}
+	const RationalArray ba {span<const EagerRational>(a)}, bb {span<const EagerRational>(b)};
+	RationalArray bc(count);
+	auto check = [&]
+	{
+		for ( size_t i = 0; i < count; ++i )
+			if ( !(bc[i] == c[i]) )  { cout << "  results differ at " << i << '\n'; break; }
+	};
+	BatchBenchmark("add", count, [&]{ Add(ba, bb, bc); },
+	               [&]{ for ( size_t i = 0; i < count; ++i )  c[i] = a[i] + b[i]; });
+	check();
+	BatchBenchmark("multiply", count, [&]{ Multiply(ba, bb, bc); },
+	               [&]{ for ( size_t i = 0; i < count; ++i )  c[i] = a[i] * b[i]; });
+	check();
+	vector<int8_t> s1(count), s2(count);
+	BatchBenchmark("compare", count, [&]{ Compare(ba, bb, span(s2)); },
+	               [&]{ for ( size_t i = 0; i < count; ++i )  s1[i] = (b[i] < a[i]) - (a[i] < b[i]); });
+	if ( s1 != s2 )  cout << "  results differ\n";
+}
+
+
+
+template <typename Map, typename Key>
+double CountingTime(Map& m, const vector<Key>& keys)
+{
+	return TimeSec([&]{ for ( const Key& k : keys )  ++m[k]; });
+}
+
+
+
+// The ++m[{1, 3}] pattern of operator_overload.cpp over random fractions
+// p/q with |p| <= range and 0 < q <= range
+void CountingBenchmark(int range)
+{
+	const size_t count = 4'000'000;
+	mt19937 gen(4);
+	uniform_int_distribution<int> num(-range, range), den(1, range);
+	vector<IntRational> k_int;
+	vector<EagerRational> keys;
+	for ( size_t i = 0; i < count; ++i )
+	{
+		const int p = num(gen), q = den(gen);
+		k_int.emplace_back(p, q);
+		keys.emplace_back(p, q);
+	}
+	map<IntRational, int> m_int;
+	map<EagerRational, int> m_tree;
+	unordered_map<EagerRational, int> m_hash;
+	RationalTable<int> m_table;
+	RationalFlatMap<int> m_flat;
+	const double sec[] = {
+		CountingTime(m_int, k_int), CountingTime(m_tree, keys), CountingTime(m_hash, keys),
+		CountingTime(m_table, keys), CountingTime(m_flat, keys) };
+
+	const vector<pair<EagerRational, int>> expected(m_tree.begin(), m_tree.end());
+	vector<pair<EagerRational, int>> hashed(m_hash.begin(), m_hash.end()), table, flat;
+	m_table.Copy(back_inserter(table));
+	m_flat.Copy(back_inserter(flat));
+	auto by_key = [](const auto& a, const auto& b) { return a.first < b.first; };
+	sort(hashed.begin(), hashed.end(), by_key);
+	sort(table.begin(), table.end(), by_key);
+	bool same = hashed == expected && table == expected && flat == expected
+	            && m_int.size() == expected.size();
+	size_t i = 0;
+	for ( const auto& [r, n] : m_int )
+	{
+		same = same && ToString(r) == ToString(expected[i].first) && n == expected[i].second;
+		++i;
+	}
+
+	cout << "|p|, q <= " << setw(3) << range << ", " << setw(5) << expected.size() << " keys:";
+	for ( double s : sec )  cout << setw(6) << s * 1e9 / count;
+	cout << (same ? "\n" : "   (counts differ)\n");
+}
+
+
+
+void CountingBenchmark()
+{
+	cout << "++m[r], ns: map<IntRational>, map, unordered_map, RationalTable, RationalFlatMap\n";
+	CountingBenchmark(20);
+	CountingBenchmark(150);
+}
+
+
+
+void ParseDemo()
+{
+	const char* texts[] = {"  -6/4", "+7/-21", "+-1/2", "5", "-9223372036854775808/2",
+	                       "-9223372036854775808", "1/0", "2/x"};
+	for ( string_view t : texts )
+	{
+		EagerRational r;
+		const from_chars_result res = FromChars(t.data(), t.data() + t.size(), r);
+		cout << '"' << t << "\": ";
+		if ( res.ec == errc() )  cout << r << '\n';
+		else  cout << make_error_code(res.ec).message() << " at " << res.ptr - t.data() << '\n';
+	}
+	char buf[rational_chars];
+	const to_chars_result res = ToChars(buf, buf + sizeof(buf), LazyRational(-3, 12));
+	cout << "ToChars: " << string_view(buf, res.ptr) << '\n';
+}
+
+
+
+// The file is written and read with operator<< and operator>> through
+// fstreams, and with FormatRationals() and ParseRationals() over the whole
+// file in memory. Eager parsing reduces every value, as operator>> does;
+// lazy parsing stores the fields as they are.
+void ParseBenchmark()
+{
+	const size_t count = 4'000'000;
+	mt19937_64 gen(5);
+	uniform_int_distribution<int64_t> num(-1'000'000'000, 1'000'000'000), den(1, 1'000'000'000);
+	vector<EagerRational> values(count), streamed(count), parsed(count);
+	vector<LazyRational> parsed_lazy(count);
+	for ( auto& r : values )  r = {num(gen), den(gen)};
+	const auto stamp = chrono::steady_clock::now().time_since_epoch().count();
+	const auto path = filesystem::temp_directory_path() / ("rationals_" + to_string(stamp));
+	auto parse = [&](auto out)
+	{
+		return TimeSec([&]{
+			string text(filesystem::file_size(path), '\0');
+			ifstream(path, ios::binary).read(text.data(), text.size());
+			const ParseResult r = ParseRationals(text, out);
+			if ( r.ec != errc() || r.count != count )  cout << "  parse error\n";
+		});
+	};
+
+	const double sec[] = {
+		TimeSec([&]{
+			ofstream out(path);
+			for ( const auto& r : values )  out << r << '\n';
+		}),
+		TimeSec([&]{
+			ifstream in(path);
+			for ( auto& r : streamed )  in >> r;
+		}),
+		TimeSec([&]{
+			const string text = FormatRationals(span<const EagerRational>(values));
+			ofstream(path, ios::binary).write(text.data(), text.size());
+		}),
+		parse(span(parsed)),
+		parse(span(parsed_lazy)) };
+	const auto bytes = filesystem::file_size(path);
+	filesystem::remove(path);
+	bool same = streamed == values && parsed == values;
+	for ( size_t i = 0; i < count; ++i )
+		same = same && parsed_lazy[i].Num() == values[i].Num() && parsed_lazy[i].Den() == values[i].Den();
+
+	cout << count / 1'000'000 << "M values, " << bytes / 1'000'000 << " MB file, M values/s:\n";
+	cout << "  write:  operator<< " << setw(6) << count / sec[0] / 1e6
+	     << ", FormatRationals " << setw(6) << count / sec[2] / 1e6 << '\n';
+	cout << "  read:   operator>> " << setw(6) << count / sec[1] / 1e6
+	     << ", ParseRationals  " << setw(6) << count / sec[3] / 1e6
+	     << " (lazy " << count / sec[4] / 1e6 << ")\n";
+	if ( !same )  cout << "  results differ\n";
+}
+
+
+
+int main()
+{
+	Demo<Reduction::eager>("eager");
+	Demo<Reduction::lazy>("lazy ");
+	OverflowDemo();
+	BatchDemo();
+	ParseDemo();
+	cout << '\n' << fixed << setprecision(1);
+	ChainBenchmark();
+	cout << '\n';
+	GcdBenchmark();
+	cout << '\n';
+	BatchBenchmark();
+	cout << '\n';
+	CountingBenchmark();
+	cout << '\n';
+	ParseBenchmark();
+}
@@ -0,0 +1,333 @@
+/*****************************************************************************
+ * This model program demonstrates the small-buffer optimization on SomeClass
+ * of ctors_oper=.cpp: up to seven elements are stored inside the object
+ * itself, so small objects are created, copied and destroyed without any
+ * heap allocation, while moving a large object still only takes its
+ * pointer.
+ * g++ small_buffer.cpp -std=c++20 -O2 -o small_buffer
+ *****************************************************************************/
+
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+using Size = uint32_t;
+using Data = int;
+
+
+
+// The class of ctors_oper=.cpp without the output of every call, kept as the
+// baseline
+
+class NewSomeClass
+{
+public:
+	explicit NewSomeClass(Size size) : size_ {size}, p_data_ {new Data[size_]} {}
+	NewSomeClass(Size size, const string& name)
+		: size_ {size}, p_data_ {new Data[size_]}, name_ {name} {}
+	NewSomeClass(const NewSomeClass& other)
+		: size_ {other.size_}, p_data_ {new Data[other.size_]}, name_ {other.name_}
+	{
+		memcpy(p_data_, other.p_data_, sizeof(Data) * size_);
+	}
+	NewSomeClass(NewSomeClass&& other)
+		: size_ {other.size_}, p_data_ {other.p_data_}, name_ {move(other.name_)}
+	{
+		other.size_ = 0;
+		other.p_data_ = nullptr;
+	}
+	~NewSomeClass() { delete[] p_data_; }
+
+	const NewSomeClass& operator =(const NewSomeClass& other)
+	{
+		if ( &other != this )
+		{
+			delete[] p_data_;
+			size_ = other.size_;
+			p_data_ = new Data[size_];
+			name_ = other.name_;
+			memcpy(p_data_, other.p_data_, sizeof(Data) * size_);
+		}
+		return *this;
+	}
+	const NewSomeClass& operator =(NewSomeClass&& other)
+	{
+		if ( &other != this )
+		{
+			delete[] p_data_;
+			size_ = other.size_;
+			p_data_ = other.p_data_;
+			name_ = move(other.name_);
+			other.size_ = 0;
+			other.p_data_ = nullptr;
+		}
+		return *this;
+	}
+
+	const NewSomeClass& DoSomething(Data value)
+	{
+		for ( Size i = 0; i < size_; ++i )  p_data_[i] = value;
+		return *this;
+	}
+	Size size() const { return size_; }
+
+private:
+	Size size_ = 0;
+	Data* p_data_ = nullptr;
+	string name_ = "DefaultName";
+};
+
+
+
+//-----------------------------------------------------------------------------
+
+
+// p_data_ points either to inline_ or to an array on the heap, so that
+// DoSomething() and the output need not know which. The inline array takes
+// what would be padding after size_ plus 24 bytes: the object grows from
+// 48 to 72 bytes. A moved-from object is empty and inline, as a new one of
+// size 0. The moves are noexcept (the original ones are not), so that
+// vector<SomeClass> moves its elements when it grows instead of copying.
+class SomeClass
+{
+public:
+	static constexpr Size inline_capacity = 7;
+
+	SomeClass() = delete;
+	explicit SomeClass(Size size);
+	SomeClass(Size size, const string& name);
+	SomeClass(const SomeClass& other);
+	SomeClass(SomeClass&& other) noexcept;
+
+	~SomeClass();
+
+	const SomeClass& operator =(const SomeClass& other);
+	const SomeClass& operator =(SomeClass&& other) noexcept;
+
+	const SomeClass& DoSomething(Data value);
+	Size size() const { return size_; }
+	bool IsInline() const { return p_data_ == inline_; }
+
+private:
+	Size size_ = 0;
+	Data inline_[inline_capacity];
+	Data* p_data_ = inline_;
+	string name_ = "DefaultName";
+
+	void Allocate(Size size);   // p_data_ is not owned yet
+	void Steal(SomeClass& other);  // Likewise
+
+	friend ostream& operator <<(ostream& out, const SomeClass& sc);
+};
+
+
+
+void SomeClass::Allocate(Size size)
+{
+	size_ = size;
+	p_data_ = (size <= inline_capacity) ? inline_ : new Data[size];
+}
+
+
+
+void SomeClass::Steal(SomeClass& other)
+{
+	size_ = other.size_;
+	if ( other.IsInline() )
+	{
+		p_data_ = inline_;
+		memcpy(inline_, other.inline_, sizeof(inline_));
+	}
+	else
+	{
+		p_data_ = other.p_data_;
+		other.p_data_ = other.inline_;
+	}
+	other.size_ = 0;
+}
+
+
+
+SomeClass::SomeClass(Size size)
+{
+	Allocate(size);
+}
+
+
+
+SomeClass::SomeClass(Size size, const string& name)
+	: name_ {name}
+{
+	Allocate(size);
+}
+
+
+
+SomeClass::SomeClass(const SomeClass& other)
+	: name_ {other.name_}
+{
+	Allocate(other.size_);
+	memcpy(p_data_, other.p_data_, sizeof(Data) * size_);
+}
+
+
+
+SomeClass::SomeClass(SomeClass&& other) noexcept
+	: name_ {move(other.name_)}
+{
+	Steal(other);
+}
+
+
+
+SomeClass::~SomeClass()
+{
+	if ( !IsInline() )  delete[] p_data_;
+}
+
+
+
+const SomeClass& SomeClass::operator =(const SomeClass& other)
+{
+	if ( &other != this )
+	{
+		if ( !IsInline() )  delete[] p_data_;
+		Allocate(other.size_);
+		name_ = other.name_;
+		memcpy(p_data_, other.p_data_, sizeof(Data) * size_);
+	}
+	return *this;
+}
+
+
+
+const SomeClass& SomeClass::operator =(SomeClass&& other) noexcept
+{
+	if ( &other != this )
+	{
+		if ( !IsInline() )  delete[] p_data_;
+		Steal(other);
+		name_ = move(other.name_);
+	}
+	return *this;
+}
+
+
+
+const SomeClass& SomeClass::DoSomething(Data value)
+{
+	for ( Size i = 0; i < size_; ++i )  p_data_[i] = value;
+	return *this;
+}
+
+
+
+ostream& operator <<(ostream& out, const SomeClass& sc)
+{
+	out << sc.name_ << ":";
+	if ( sc.size_ == 0 )  out << " empty";
+	for ( Size i = 0; i < sc.size_; ++i )  out << ' ' << sc.p_data_[i];
+	return out;
+}
+
+
+
+//-----------------------------------------------------------------------------
+
+
+template <typename F>
+double TimeSec(F f)
+{
+	const auto t = chrono::steady_clock::now();
+	f();
+	return chrono::duration<double>(chrono::steady_clock::now() - t).count();
+}
+
+
+
+// Copies and moves between the inline and the heap states
+void Demo()
+{
+	cout << "sizeof: NewSomeClass " << sizeof(NewSomeClass) << ", SomeClass " << sizeof(SomeClass)
+	     << '\n';
+	SomeClass small(5, "Small"), large(9, "Large");
+	small.DoSomething(1);
+	large.DoSomething(2);
+	SomeClass a(small), b(large);
+	assert( a.IsInline() && !b.IsInline() );
+	a = large;
+	b = small;
+	assert( !a.IsInline() && b.IsInline() );
+	cout << a << '\n' << b << '\n';
+
+	SomeClass c(move(a)), d(move(b));
+	assert( !c.IsInline() && d.IsInline() && a.IsInline() && a.size() == 0 );
+	cout << c << '\n' << d << '\n' << a << '\n';
+	c = move(d);
+	d = move(large);
+	assert( c.IsInline() && !d.IsInline() && large.size() == 0 );
+	cout << c << '\n' << d << '\n';
+	c = c;
+	c = move(c);
+	cout << c << "\n\n";
+}
+
+
+
+// Times per object of construction, copy construction, move assignment
+// (which frees the array of the target) and emplace_back() into a vector
+// without reserve(): the best of three runs
+template <typename T>
+void Benchmark(Size size)
+{
+	const size_t count = max<size_t>(1'000, 2'000'000 / size);
+	double best[4] = {1e9, 1e9, 1e9, 1e9};
+	for ( int run = 0; run < 3; ++run )
+	{
+		vector<T> objects, copies;
+		objects.reserve(count);
+		copies.reserve(count);
+		const double sec[] = {
+			TimeSec([&]{ for ( size_t i = 0; i < count; ++i )  objects.emplace_back(size); }),
+			TimeSec([&]{ for ( const auto& sc : objects )  copies.push_back(sc); }),
+			TimeSec([&]{ for ( size_t i = 0; i < count; ++i )  objects[i] = move(copies[i]); }),
+			TimeSec([&]{
+				vector<T> v;
+				for ( size_t i = 0; i < count; ++i )  v.emplace_back(size);
+			}) };
+		for ( int k = 0; k < 4; ++k )  best[k] = min(best[k], sec[k]);
+	}
+	for ( double s : best )  cout << setw(8) << s * 1e9 / count;
+}
+
+
+
+void Benchmark()
+{
+	cout << "ns per object: construct    copy    move  vector growth\n";
+	for ( Size size : {1, 4, 7, 8, 16, 64, 256, 1024} )
+	{
+		cout << setw(4) << size << "  new[]";
+		Benchmark<NewSomeClass>(size);
+		cout << "\n      SBO  ";
+		Benchmark<SomeClass>(size);
+		cout << '\n';
+	}
+}
+
+
+
+int main()
+{
+	Demo();
+	cout << fixed << setprecision(1);
+	Benchmark();
+}
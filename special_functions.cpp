@@ -0,0 +1,309 @@
+/*****************************************************************************
+ * This model program demonstrates how to speed up repeated evaluation of
+ * special functions: batch evaluation over arrays, three-term recurrences
+ * giving all orders 0..n in one pass and interpolation tables built on demand.
+ * g++ special_functions.cpp -std=c++20 -O2 -o special_functions
+ *****************************************************************************/
+
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+using namespace std;
+
+
+
+// Three-term recurrences fill out[0..n] with the values of all orders at x.
+// Each of them costs O(n) instead of n separate calls to std:: functions.
+
+void HermiteAll(unsigned n, double x, span<double> out)
+{
+	out[0] = 1;
+	if ( n > 0 )  out[1] = 2 * x;
+	for ( unsigned k = 1; k < n; ++k )  // H(k+1) = 2x H(k) - 2k H(k-1)
+		out[k + 1] = 2 * x * out[k] - 2 * k * out[k - 1];
+}
+
+
+
+void LaguerreAll(unsigned n, double x, span<double> out)
+{
+	out[0] = 1;
+	if ( n > 0 )  out[1] = 1 - x;
+	for ( unsigned k = 1; k < n; ++k )  // (k+1) L(k+1) = (2k+1-x) L(k) - k L(k-1)
+		out[k + 1] = ((2 * k + 1 - x) * out[k] - k * out[k - 1]) / (k + 1);
+}
+
+
+
+void LegendreAll(unsigned n, double x, span<double> out)
+{
+	out[0] = 1;
+	if ( n > 0 )  out[1] = x;
+	for ( unsigned k = 1; k < n; ++k )  // (k+1) P(k+1) = (2k+1) x P(k) - k P(k-1)
+		out[k + 1] = ((2 * k + 1) * x * out[k] - k * out[k - 1]) / (k + 1);
+}
+
+
+
+// Batch versions: the same recurrences for a fixed order n over an array of
+// arguments. The inner loops run over x, have no dependencies between
+// iterations and are auto-vectorized by the compiler.
+
+void HermiteBatch(unsigned n, span<const double> x, span<double> out)
+{
+	const size_t size = x.size();
+	vector<double> prev(size, 1.0);
+	for ( size_t i = 0; i < size; ++i )  out[i] = (n == 0) ? 1 : 2 * x[i];
+	for ( unsigned k = 1; k < n; ++k )
+		for ( size_t i = 0; i < size; ++i )
+		{
+			const double next = 2 * x[i] * out[i] - 2.0 * k * prev[i];
+			prev[i] = out[i];
+			out[i] = next;
+		}
+}
+
+
+
+void LaguerreBatch(unsigned n, span<const double> x, span<double> out)
+{
+	const size_t size = x.size();
+	vector<double> prev(size, 1.0);
+	for ( size_t i = 0; i < size; ++i )  out[i] = (n == 0) ? 1 : 1 - x[i];
+	for ( unsigned k = 1; k < n; ++k )
+	{
+		const double inv = 1.0 / (k + 1);
+		for ( size_t i = 0; i < size; ++i )
+		{
+			const double next = ((2 * k + 1 - x[i]) * out[i] - k * prev[i]) * inv;
+			prev[i] = out[i];
+			out[i] = next;
+		}
+	}
+}
+
+
+
+void LegendreBatch(unsigned n, span<const double> x, span<double> out)
+{
+	const size_t size = x.size();
+	vector<double> prev(size, 1.0);
+	for ( size_t i = 0; i < size; ++i )  out[i] = (n == 0) ? 1 : x[i];
+	for ( unsigned k = 1; k < n; ++k )
+	{
+		const double inv = 1.0 / (k + 1);
+		for ( size_t i = 0; i < size; ++i )
+		{
+			const double next = ((2 * k + 1) * x[i] * out[i] - k * prev[i]) * inv;
+			prev[i] = out[i];
+			out[i] = next;
+		}
+	}
+}
+
+
+
+// Piecewise cubic interpolation of f on a uniform grid over [a, b]. The grid
+// is refined until the error at points between the nodes is below 'tol'
+// (relative for |f| > 1, absolute otherwise).
+class InterpolationTable
+{
+public:
+	InterpolationTable(const function<double(double)>& f,
+	                   double a, double b, double tol);
+	double operator()(double x) const;
+	void Evaluate(span<const double> x, span<double> out) const;
+	size_t Nodes() const { return values_.size(); }
+
+private:
+	double a_;
+	double b_;
+	double inv_h_ = 0;
+	vector<double> values_;
+
+	static constexpr size_t max_nodes_ = 1 << 22;
+	void Build(const function<double(double)>& f, size_t intervals);
+};
+
+
+
+InterpolationTable::InterpolationTable(const function<double(double)>& f,
+                                       double a, double b, double tol)
+	: a_ {a}, b_ {b}
+{
+	if ( !(a < b) )  throw invalid_argument("InterpolationTable: empty domain");
+	for ( size_t intervals = 16; ; intervals *= 2 )
+	{
+		if ( intervals + 1 > max_nodes_ )
+			throw runtime_error("InterpolationTable: tolerance is not reachable");
+		Build(f, intervals);
+		double max_err = 0;
+		const double h = (b_ - a_) / intervals;
+		for ( size_t i = 0; i < intervals; ++i )
+			for ( double t : {0.25, 0.5, 0.75} )
+			{
+				const double x = a_ + (i + t) * h;
+				const double exact = f(x);
+				const double err = abs((*this)(x) - exact) / max(1.0, abs(exact));
+				max_err = max(max_err, err);
+			}
+		if ( max_err <= tol )  break;
+	}
+}
+
+
+
+void InterpolationTable::Build(const function<double(double)>& f, size_t intervals)
+{
+	const double h = (b_ - a_) / intervals;
+	inv_h_ = 1 / h;
+	values_.resize(intervals + 1);
+	for ( size_t i = 0; i <= intervals; ++i )  values_[i] = f(a_ + i * h);
+}
+
+
+
+// Outside [a, b] the end pieces are extrapolated; u is clamped before the
+// conversion, which is undefined for NaN and for values beyond ptrdiff_t.
+double InterpolationTable::operator()(double x) const
+{
+	if ( isnan(x) )  return x;
+	const double u = (x - a_) * inv_h_;
+	const ptrdiff_t last = static_cast<ptrdiff_t>(values_.size()) - 3;
+	const ptrdiff_t i = static_cast<ptrdiff_t>(clamp(u, 1.0, static_cast<double>(last)));
+	const double t = u - i;
+	const double* y = &values_[i - 1];
+	// Lagrange weights for the nodes i-1, i, i+1, i+2
+	const double tm1 = t - 1, tm2 = t - 2, tp1 = t + 1;
+	return (-t * tm1 * tm2 * y[0] + 3 * tp1 * tm1 * tm2 * y[1]
+	        - 3 * tp1 * t * tm2 * y[2] + tp1 * t * tm1 * y[3]) / 6;
+}
+
+
+
+void InterpolationTable::Evaluate(span<const double> x, span<double> out) const
+{
+	for ( size_t i = 0; i < x.size(); ++i )  out[i] = (*this)(x[i]);
+}
+
+
+
+// Tables are built on the first request and reused afterwards. A table is
+// found by its name and range, not by f, which cannot be compared: a name
+// must always stand for the same function, and later requests may pass no f.
+class TableCache
+{
+public:
+	const InterpolationTable& Get(const string& name, double a, double b, double tol,
+	                              const function<double(double)>& f)
+	{
+		const auto key = make_tuple(name, a, b, tol);
+		auto it = tables_.find(key);
+		if ( it == tables_.end() )
+			it = tables_.emplace(key, InterpolationTable(f, a, b, tol)).first;
+		return it->second;
+	}
+
+private:
+	map<tuple<string, double, double, double>, InterpolationTable> tables_;
+};
+
+
+
+template <typename F>
+double TimeMs(F f)
+{
+	const auto t = chrono::steady_clock::now();
+	f();
+	return chrono::duration<double, milli>(chrono::steady_clock::now() - t).count();
+}
+
+
+
+double MaxDiff(span<const double> a, span<const double> b)
+{
+	double d = 0;
+	for ( size_t i = 0; i < a.size(); ++i )
+		d = max(d, abs(a[i] - b[i]) / max(1.0, abs(b[i])));
+	return d;
+}
+
+
+
+int main()
+{
+	cout << setprecision(10);
+	{   // All orders in one pass agree with std:: functions
+		const unsigned n = 5;
+		vector<double> h(n + 1), l(n + 1), p(n + 1);
+		HermiteAll(n, 4, h);
+		LaguerreAll(n, 0.5, l);
+		LegendreAll(n, 0.25, p);
+		for ( unsigned k = 0; k <= n; ++k )
+			cout << "k = " << k << ":  " << h[k] << " (" << hermite(k, 4) << ")  "
+			     << l[k] << " (" << laguerre(k, 0.5) << ")  "
+			     << p[k] << " (" << legendre(k, 0.25) << ")\n";
+	}
+
+	const size_t count = 1'000'000;
+	mt19937 gen(12345);
+	uniform_real_distribution<double> distr(-1.0, 1.0);
+	vector<double> x(count), ref(count), res(count);
+	for ( auto& v : x )  v = distr(gen);
+
+	cout << fixed << setprecision(2) << "\nBatch evaluation, "
+	     << count << " arguments, order 20:\n";
+	{
+		const unsigned n = 20;
+		double t1 = TimeMs([&]{ for ( size_t i = 0; i < count; ++i )  ref[i] = hermite(n, x[i]); });
+		double t2 = TimeMs([&]{ HermiteBatch(n, x, res); });
+		cout << "hermite:   std " << t1 << " ms, batch " << t2 << " ms, max rel. diff "
+		     << scientific << MaxDiff(res, ref) << fixed << '\n';
+		vector<double> xp(count);  // Laguerre polynomials are defined for x >= 0
+		for ( size_t i = 0; i < count; ++i )  xp[i] = x[i] + 1;
+		t1 = TimeMs([&]{ for ( size_t i = 0; i < count; ++i )  ref[i] = laguerre(n, xp[i]); });
+		t2 = TimeMs([&]{ LaguerreBatch(n, xp, res); });
+		cout << "laguerre:  std " << t1 << " ms, batch " << t2 << " ms, max rel. diff "
+		     << scientific << MaxDiff(res, ref) << fixed << '\n';
+		t1 = TimeMs([&]{ for ( size_t i = 0; i < count; ++i )  ref[i] = legendre(n, x[i]); });
+		t2 = TimeMs([&]{ LegendreBatch(n, x, res); });
+		cout << "legendre:  std " << t1 << " ms, batch " << t2 << " ms, max rel. diff "
+		     << scientific << MaxDiff(res, ref) << fixed << '\n';
+	}
+
+	cout << "\nInterpolation tables, tol = 1e-10, time per value:\n";
+	TableCache cache;
+	// Per-call std:: functions are timed on the first 'calls' arguments only:
+	// riemann_zeta() takes about 0.1 ms per value.
+	auto bench = [&](const string& name, double a, double b, size_t calls,
+	                 function<double(double)> f)
+	{
+		for ( auto& v : x )  v = a + (b - a) * (distr(gen) + 1) / 2;
+		const InterpolationTable* table = nullptr;
+		const double t0 = TimeMs([&]{ table = &cache.Get(name, a, b, 1e-10, f); });
+		const double t1 = TimeMs([&]{ for ( size_t i = 0; i < calls; ++i )  ref[i] = f(x[i]); });
+		const double t2 = TimeMs([&]{ table->Evaluate(x, res); });
+		cout << setw(14) << left << name << right << " std " << setw(8) << t1 * 1e6 / calls
+		     << " ns, table " << setw(5) << t2 * 1e6 / count << " ns (build " << t0
+		     << " ms, " << table->Nodes() << " nodes), max rel. diff " << scientific
+		     << MaxDiff(span(res).first(calls), span(ref).first(calls)) << fixed << '\n';
+	};
+	bench("cyl_bessel_j2", 0, 20, count, [](double v){ return cyl_bessel_j(2.0, v); });
+	bench("riemann_zeta", 2, 10, count / 1000, [](double v){ return riemann_zeta(v); });
+	bench("tgamma", 1, 5, count, [](double v){ return tgamma(v); });
+	bench("beta(3, .)", 1, 5, count, [](double v){ return beta(3.0, v); });
+	const double t = TimeMs([&]{ cache.Get("riemann_zeta", 2, 10, 1e-10, nullptr); });
+	cout << "Second request of the zeta table: " << t << " ms (cached)\n";
+	const InterpolationTable& gamma = cache.Get("tgamma", 1, 5, 1e-10, nullptr);
+	cout << "tgamma table at NaN: " << gamma(NAN) << '\n';
+}
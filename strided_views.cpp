@@ -0,0 +1,532 @@
+/*****************************************************************************
+ * This model program demonstrates non-owning strided, gathered and masked
+ * views over contiguous buffers (zero-copy analogues of valarray's slice,
+ * gslice and mask), a small expression template engine and reductions that
+ * work on views without materializing them.
+ * g++ strided_views.cpp -std=c++20 -O3 -march=native -o strided_views
+ *****************************************************************************/
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <concepts>
+#include <cstdint>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <valarray>
+#include <vector>
+
+using namespace std;
+
+
+
+struct ExprBase {};  // Tag of every view and expression
+
+template <typename E>
+concept Expr = derived_from<remove_cvref_t<E>, ExprBase>;
+
+
+
+// Every n-th element of a buffer, the counterpart of slice_array. The
+// stride must not be 0 (which slice allows): all the iterators of such a
+// view would be equal, and their distance a division by zero.
+template <typename T>
+class StridedView : public ExprBase
+{
+public:
+	using value_type = remove_const_t<T>;
+
+	StridedView(T* data, size_t size, size_t stride)
+		: data_ {data}, size_ {size}, stride_ {stride}
+	{
+		if ( stride == 0 )  throw invalid_argument("StridedView: stride 0");
+	}
+	StridedView(T* base, const slice& s)
+		: StridedView(base + s.start(), s.size(), s.stride()) {}
+	StridedView(const StridedView&) = default;
+
+	// Assignment writes through the view, as for slice_array
+	StridedView& operator =(const StridedView& other) { return Assign(other); }
+	template <Expr E> StridedView& operator =(const E& e) { return Assign(e); }
+	StridedView& operator =(value_type v)
+	{
+		for ( size_t i = 0; i < size_; ++i )  (*this)[i] = v;
+		return *this;
+	}
+	template <Expr E> StridedView& operator +=(const E& e)
+	{
+		for ( size_t i = 0; i < size_; ++i )  (*this)[i] += e[i];
+		return *this;
+	}
+
+	size_t size() const { return size_; }
+	size_t Stride() const { return stride_; }
+	T* Data() const { return data_; }
+	T& operator [](size_t i) const { return data_[i * stride_]; }
+
+	// Random access, so that std::sort() works in place. It holds an index,
+	// not a pointer: end() must not point beyond the last element plus one.
+	class Iterator
+	{
+	public:
+		using iterator_category = random_access_iterator_tag;
+		using value_type = StridedView::value_type;
+		using difference_type = ptrdiff_t;
+		using pointer = T*;
+		using reference = T&;
+
+		Iterator() = default;
+		Iterator(T* data, ptrdiff_t stride, ptrdiff_t i) : data_ {data}, stride_ {stride}, i_ {i} {}
+		T& operator *() const { return data_[i_ * stride_]; }
+		T& operator [](ptrdiff_t n) const { return data_[(i_ + n) * stride_]; }
+		Iterator& operator ++() { ++i_; return *this; }
+		Iterator& operator --() { --i_; return *this; }
+		Iterator operator ++(int) { Iterator t = *this; ++i_; return t; }
+		Iterator operator --(int) { Iterator t = *this; --i_; return t; }
+		Iterator& operator +=(ptrdiff_t n) { i_ += n; return *this; }
+		Iterator& operator -=(ptrdiff_t n) { i_ -= n; return *this; }
+		friend Iterator operator +(Iterator it, ptrdiff_t n) { return it += n; }
+		friend Iterator operator +(ptrdiff_t n, Iterator it) { return it += n; }
+		friend Iterator operator -(Iterator it, ptrdiff_t n) { return it -= n; }
+		friend ptrdiff_t operator -(const Iterator& a, const Iterator& b) { return a.i_ - b.i_; }
+		friend bool operator ==(const Iterator& a, const Iterator& b) { return a.i_ == b.i_; }
+		friend auto operator <=>(const Iterator& a, const Iterator& b) { return a.i_ <=> b.i_; }
+
+	private:
+		T* data_ = nullptr;
+		ptrdiff_t stride_ = 1;
+		ptrdiff_t i_ = 0;
+	};
+
+	Iterator begin() const { return {data_, static_cast<ptrdiff_t>(stride_), 0}; }
+	Iterator end() const
+	{
+		return {data_, static_cast<ptrdiff_t>(stride_), static_cast<ptrdiff_t>(size_)};
+	}
+
+private:
+	T* data_;
+	size_t size_;
+	size_t stride_;
+
+	template <typename E> StridedView& Assign(const E& e)
+	{
+		for ( size_t i = 0; i < size_; ++i )  (*this)[i] = e[i];
+		return *this;
+	}
+};
+
+
+
+// Elements at arbitrary positions, the counterpart of indirect_array. Only
+// the indices are stored (32-bit, which suits the hardware gather
+// instructions the compiler may use), never the elements themselves, so no
+// index may reach 2^32. They are shared, so copying the view into an
+// expression stays cheap.
+template <typename T>
+class GatherView : public ExprBase
+{
+public:
+	using value_type = remove_const_t<T>;
+
+	GatherView(T* data, vector<uint32_t> indices)
+		: data_ {data}, indices_ {make_shared<const vector<uint32_t>>(move(indices))} {}
+	GatherView(T* base, const gslice& gs);  // The same indices as valarray[gs]
+
+	template <Expr E> GatherView& operator =(const E& e)
+	{
+		for ( size_t i = 0; i < size(); ++i )  (*this)[i] = e[i];
+		return *this;
+	}
+
+	size_t size() const { return indices_->size(); }
+	T& operator [](size_t i) const { return data_[(*indices_)[i]]; }
+	T* Data() const { return data_; }
+	const vector<uint32_t>& Indices() const { return *indices_; }
+
+private:
+	T* data_;
+	shared_ptr<const vector<uint32_t>> indices_;
+
+	static vector<uint32_t> Indices(const gslice& gs);
+};
+
+
+
+template <typename T>
+GatherView<T>::GatherView(T* base, const gslice& gs) : GatherView(base, Indices(gs)) {}
+
+
+
+template <typename T>
+vector<uint32_t> GatherView<T>::Indices(const gslice& gs)
+{
+	const valarray<size_t>& lengths = gs.size();
+	const valarray<size_t>& strides = gs.stride();
+	const size_t dims = lengths.size();
+	size_t total = 1, last = gs.start();
+	for ( size_t d = 0; d < dims; ++d )
+	{
+		total *= lengths[d];
+		if ( lengths[d] != 0 )  last += (lengths[d] - 1) * strides[d];
+	}
+	if ( total != 0 && last > numeric_limits<uint32_t>::max() )
+		throw out_of_range("GatherView: index beyond 32 bits");
+	vector<uint32_t> indices;
+	indices.reserve(total);
+	vector<size_t> pos(dims, 0);  // Multi-index, the last dimension runs fastest
+	for ( size_t n = 0; n < total; ++n )
+	{
+		size_t index = gs.start();
+		for ( size_t d = 0; d < dims; ++d )  index += pos[d] * strides[d];
+		indices.push_back(static_cast<uint32_t>(index));
+		for ( size_t d = dims; d-- > 0; )
+		{
+			if ( ++pos[d] < lengths[d] )  break;
+			pos[d] = 0;
+		}
+	}
+	return indices;
+}
+
+
+
+// Elements where the mask is true, the counterpart of mask_array. Positions
+// are found once so that the view composes with expressions; reductions
+// scan the whole buffer with a branchless select instead.
+template <typename T>
+class MaskView : public GatherView<T>
+{
+public:
+	MaskView(T* data, span<const bool> mask)
+		: GatherView<T>(data, Positions(mask)), mask_ {mask} {}
+	span<const bool> Mask() const { return mask_; }
+
+	using GatherView<T>::operator=;
+
+private:
+	span<const bool> mask_;
+
+	static vector<uint32_t> Positions(span<const bool> mask)
+	{
+		if ( mask.size() > size_t {numeric_limits<uint32_t>::max()} + 1 )
+			throw out_of_range("MaskView: mask longer than 2^32");
+		vector<uint32_t> positions;
+		for ( size_t i = 0; i < mask.size(); ++i )
+			if ( mask[i] )  positions.push_back(static_cast<uint32_t>(i));
+		return positions;
+	}
+};
+
+
+
+//-----------------------------------------------------------------------------
+
+
+template <typename T>
+class Scalar : public ExprBase
+{
+public:
+	using value_type = T;
+	explicit Scalar(T v) : v_ {v} {}
+	T operator [](size_t) const { return v_; }
+	size_t size() const { return numeric_limits<size_t>::max(); }
+
+private:
+	T v_;
+};
+
+
+
+// Element-wise node of an expression tree, evaluated lazily element by element.
+// Views are stored by value: they are only a pointer and a few sizes.
+template <typename L, typename R, typename Op>
+class BinaryExpr : public ExprBase
+{
+public:
+	using value_type = decltype(Op {}(declval<L>()[0], declval<R>()[0]));
+
+	BinaryExpr(const L& lhs, const R& rhs) : lhs_ {lhs}, rhs_ {rhs} {}
+	value_type operator [](size_t i) const { return Op {}(lhs_[i], rhs_[i]); }
+	size_t size() const { return min(lhs_.size(), rhs_.size()); }
+
+private:
+	L lhs_;
+	R rhs_;
+};
+
+
+
+template <typename T>
+decltype(auto) Wrap(const T& v)
+{
+	if constexpr ( Expr<T> )  return (v);
+	else  return Scalar<T>(v);
+}
+
+template <typename L, typename R>
+concept Operands = (Expr<L> || Expr<R>)
+	&& (Expr<L> || is_arithmetic_v<L>) && (Expr<R> || is_arithmetic_v<R>);
+
+template <typename Op, typename L, typename R>
+auto MakeExpr(const L& lhs, const R& rhs)
+{
+	using WL = remove_cvref_t<decltype(Wrap(lhs))>;
+	using WR = remove_cvref_t<decltype(Wrap(rhs))>;
+	return BinaryExpr<WL, WR, Op>(Wrap(lhs), Wrap(rhs));
+}
+
+template <typename L, typename R> requires Operands<L, R>
+auto operator +(const L& lhs, const R& rhs) { return MakeExpr<plus<>>(lhs, rhs); }
+
+template <typename L, typename R> requires Operands<L, R>
+auto operator -(const L& lhs, const R& rhs) { return MakeExpr<minus<>>(lhs, rhs); }
+
+template <typename L, typename R> requires Operands<L, R>
+auto operator *(const L& lhs, const R& rhs) { return MakeExpr<multiplies<>>(lhs, rhs); }
+
+template <typename L, typename R> requires Operands<L, R>
+auto operator /(const L& lhs, const R& rhs) { return MakeExpr<divides<>>(lhs, rhs); }
+
+
+
+//-----------------------------------------------------------------------------
+
+
+// Reductions take any view or expression. Four independent accumulators
+// let the compiler vectorize the loop (with gathers for strided and indexed
+// access when the target has them).
+template <Expr E, typename Op>
+auto Reduce(const E& e, typename E::value_type init, Op op)
+{
+	using T = typename E::value_type;
+	T acc[4] = {init, init, init, init};
+	size_t i = 0;
+	const size_t n = e.size();
+	for ( ; i + 4 <= n; i += 4 )
+		for ( size_t l = 0; l < 4; ++l )  acc[l] = op(acc[l], e[i + l]);
+	for ( ; i < n; ++i )  acc[0] = op(acc[0], e[i]);
+	return op(op(acc[0], acc[1]), op(acc[2], acc[3]));
+}
+
+template <typename T>
+struct MinOf { T operator ()(T a, T b) const { return b < a ? b : a; } };
+
+template <typename T>
+struct MaxOf { T operator ()(T a, T b) const { return a < b ? b : a; } };
+
+template <Expr E>
+auto Sum(const E& e) { return Reduce(e, typename E::value_type {}, plus<>()); }
+
+template <Expr E>
+auto Min(const E& e)
+{
+	using T = typename E::value_type;
+	return Reduce(e, numeric_limits<T>::max(), MinOf<T>());
+}
+
+template <Expr E>
+auto Max(const E& e)
+{
+	using T = typename E::value_type;
+	return Reduce(e, numeric_limits<T>::lowest(), MaxOf<T>());
+}
+
+// A unit-stride view is just a contiguous range: summed through a plain
+// pointer, the loop has no multiplication by the stride and vectorizes
+// with ordinary loads instead of gathers
+template <typename T>
+auto Sum(const StridedView<T>& v)
+{
+	using V = remove_const_t<T>;
+	if ( v.Stride() != 1 )  return Reduce(v, V {}, plus<>());
+	const T* data = v.Data();
+	V acc[4] {};
+	size_t i = 0;
+	for ( ; i + 4 <= v.size(); i += 4 )
+		for ( size_t l = 0; l < 4; ++l )  acc[l] += data[i + l];
+	for ( ; i < v.size(); ++i )  acc[0] += data[i];
+	return (acc[0] + acc[1]) + (acc[2] + acc[3]);
+}
+
+// x if keep, else 0, on the bits: GCC compiles keep ? x : 0 to a branch,
+// which a random mask mispredicts half of the time
+template <typename V>
+V Select(bool keep, V x)
+{
+	using U = conditional_t<sizeof(V) == 8, uint64_t, conditional_t<sizeof(V) == 4, uint32_t,
+	                        conditional_t<sizeof(V) == 2, uint16_t, uint8_t>>>;
+	static_assert(is_arithmetic_v<V> && sizeof(V) == sizeof(U));
+	return bit_cast<V>(static_cast<U>(bit_cast<U>(x) & static_cast<U>(-static_cast<U>(keep))));
+}
+
+// Masked sum over the whole buffer without branches or indices: unselected
+// elements are replaced by zero, so they may be inf or NaN.
+template <typename T>
+auto Sum(const MaskView<T>& v)
+{
+	using V = remove_const_t<T>;
+	const span<const bool> mask = v.Mask();
+	const T* data = v.Data();
+	V acc[4] {};
+	size_t i = 0;
+	for ( ; i + 4 <= mask.size(); i += 4 )
+		for ( size_t l = 0; l < 4; ++l )  acc[l] += Select(mask[i + l], data[i + l]);
+	for ( ; i < mask.size(); ++i )  acc[0] += Select(mask[i], data[i]);
+	return (acc[0] + acc[1]) + (acc[2] + acc[3]);
+}
+
+
+
+template <Expr E>
+void Print(const E& e)
+{
+	for ( size_t i = 0; i < e.size(); ++i )  cout << e[i] << ' ';
+	cout << '\n';
+}
+
+
+
+template <typename F>
+double TimeMs(F f)
+{
+	const auto t = chrono::steady_clock::now();
+	f();
+	return chrono::duration<double, milli>(chrono::steady_clock::now() - t).count();
+}
+
+
+
+// Column statistics of a row-major table: each column is copied into a
+// vector and reduced, or reduced in place through a strided view.
+void ColumnBenchmark(size_t rows, size_t cols)
+{
+	mt19937 gen(7);
+	uniform_real_distribution<double> distr(0, 100);
+	vector<double> table(rows * cols);
+	for ( auto& x : table )  x = distr(gen);
+	vector<double> sum1(cols), sum2(cols), sum3(cols), min2(cols), max2(cols);
+
+	const double t1 = TimeMs([&]
+	{
+		vector<double> column(rows);
+		for ( size_t j = 0; j < cols; ++j )
+		{
+			for ( size_t i = 0; i < rows; ++i )  column[i] = table[i * cols + j];
+			sum1[j] = accumulate(column.begin(), column.end(), 0.0);
+		}
+	});
+	valarray<double> va(table.data(), table.size());
+	const double t2 = TimeMs([&]
+	{
+		for ( size_t j = 0; j < cols; ++j )
+		{
+			valarray<double> column = va[slice(j, rows, cols)];
+			sum3[j] = column.sum();
+		}
+	});
+	const double t3 = TimeMs([&]
+	{
+		for ( size_t j = 0; j < cols; ++j )
+			sum2[j] = Sum(StridedView<const double>(table.data() + j, rows, cols));
+	});
+	const double t4 = TimeMs([&]
+	{
+		for ( size_t j = 0; j < cols; ++j )
+		{
+			StridedView<const double> column(table.data(), slice(j, rows, cols));
+			min2[j] = Min(column);
+			max2[j] = Max(column);
+		}
+	});
+	double diff = 0;
+	for ( size_t j = 0; j < cols; ++j )
+		diff = max({diff, abs(sum1[j] - sum2[j]), abs(sum1[j] - sum3[j])});
+	cout << rows << 'x' << cols << " table, column sums:  copy + accumulate " << t1
+	     << " ms, valarray slice " << t2 << " ms, strided view " << t3
+	     << " ms (min and max " << t4 << " ms), max diff " << scientific << diff
+	     << fixed << '\n';
+}
+
+
+
+void MaskBenchmark(size_t size)
+{
+	mt19937 gen(11);
+	uniform_real_distribution<double> distr(-1, 1);
+	valarray<double> va(size);
+	for ( auto& x : va )  x = distr(gen);
+	const valarray<bool> mask = va > 0.0;
+	vector<bool> tmp(begin(mask), end(mask));
+	unique_ptr<bool[]> bits(new bool[size]);
+	copy(tmp.begin(), tmp.end(), bits.get());
+
+	double s1 = 0, s2 = 0, s3 = 0;
+	const double t1 = TimeMs([&]{ s1 = valarray<double>(va[mask]).sum(); });
+	MaskView<double> view(&va[0], span<const bool>(bits.get(), size));
+	const double t2 = TimeMs([&]{ s2 = Sum(view); });
+	const double t3 = TimeMs([&]{ s3 = Sum(GatherView<double>(&va[0], view.Indices())); });
+	cout << size << " elements, masked sum:  valarray mask " << t1 << " ms, mask view "
+	     << t2 << " ms, gather view " << t3 << " ms, diff " << scientific
+	     << max(abs(s1 - s2), abs(s1 - s3)) << fixed << '\n';
+}
+
+
+
+int main()
+{
+	vector<int> v {1, 4, 2, 9, 5, 3, 8, 7, 6, 0, 11, 10};
+
+	StridedView<int> odd(v.data(), slice(1, 6, 2));  // v[1], v[3], ... without copying
+	Print(odd);
+	cout << Sum(odd) << ' ' << Min(odd) << ' ' << Max(odd) << '\n';
+	sort(odd.begin(), odd.end());  // In place, even elements are untouched
+	for ( int x : v )  cout << x << ' ';
+	cout << '\n';
+
+	StridedView<int> even(v.data(), slice(0, 6, 2));
+	cout << Sum(even * odd + 1) << '\n';  // Lazy expression, no temporaries
+	even = even * 10 + odd;               // Written back into v
+	for ( int x : v )  cout << x << ' ';
+	cout << '\n';
+
+	// 2 x 3 block of a 4 x 3 matrix, as in valarray[gslice]
+	GatherView<int> block(v.data(), gslice(3, {2, 3}, {3, 1}));
+	Print(block);
+	cout << Sum(block) << '\n';
+
+	bool mask[12] {};
+	for ( size_t i = 0; i < v.size(); ++i )  mask[i] = v[i] % 2 == 0;
+	MaskView<int> evens(v.data(), mask);
+	Print(evens);
+	cout << Sum(evens) << ' ' << Max(evens) << '\n';
+	evens = evens / 2;
+	for ( int x : v )  cout << x << ' ';
+	cout << '\n';
+
+	double w[4] {1, NAN, 2, -INFINITY};
+	const bool finite[4] {true, false, true, false};
+	cout << Sum(MaskView<double>(w, finite)) << '\n';  // 3: the NaN and -inf are not selected
+	try
+	{
+		GatherView<double> far(w, gslice(0, {2}, {size_t {1} << 32}));
+	}
+	catch ( const out_of_range& e )
+	{
+		cout << e.what() << "\n\n";
+	}
+
+	cout << fixed << setprecision(2);
+	ColumnBenchmark(4096, 512);
+	ColumnBenchmark(100'000, 16);
+	MaskBenchmark(10'000'000);
+}
@@ -0,0 +1,1770 @@
+/*****************************************************************************
+ * This model program demonstrates fast processing of large text files split
+ * into words: a tokenizer over a memory-mapped file (or read() for pipes)
+ * that yields string_view words without copying, and a parallel sort-unique
+ * pipeline, an external merge sort for inputs larger than memory and a
+ * string interning table built on it, compared with the
+ * istream_iterator<string> functions from stream_iterators.cpp; an
+ * output iterator that bypasses iostreams; and word frequency counting,
+ * exact or approximate in bounded memory.
+ * g++ word_processing.cpp -std=c++20 -O3 -march=native -pthread -o word_processing
+ * ./word_processing [file]  (a test file is generated if none is given)
+ *****************************************************************************/
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <charconv>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <fcntl.h>
+#include <malloc.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+using namespace std;
+
+
+
+// Reads from 'in', sorts the words read, eliminates duplicate words,
+// and writes the result to 'out' (Func1 of stream_iterators.cpp).
+void Func1(istream& in, ostream& out)
+{
+	istream_iterator<string> ii {in};
+	istream_iterator<string> eos {};
+	vector<string> v {ii, eos};
+	sort(v.begin(), v.end());
+
+	ostream_iterator<string> oi {out, ", "};  // with delimiter ", "
+	unique_copy(v.begin(), v.end(), oi);
+}
+
+
+
+void Func2(istream& in, ostream& out)  // The same as Func1(), but shorter
+{
+	set<string> s { istream_iterator<string> {in},
+	                istream_iterator<string> {} };
+	copy( s.begin(), s.end(), ostream_iterator<string> {out, ", "} );
+}
+
+
+
+//-----------------------------------------------------------------------------
+
+
+// GCC/Clang vector extension: 64 bytes compared at once
+using Bytes = uint8_t __attribute__((vector_size(64)));
+
+// Bit i is set if p[i] is a space character of the "C" locale, i.e. one of
+// those that operator>> skips: ' ', '\t', '\n', '\v', '\f' and '\r'.
+// The compares are vector instructions; every 8 flag bytes of 0 or 1 are
+// then gathered into 8 bits by one multiplication.
+inline uint64_t SpaceMask(const char* p)
+{
+	Bytes b;
+	memcpy(&b, p, sizeof(b));
+	const Bytes flags = ((b == ' ') | (b - '\t' < 5)) & 1;
+	uint64_t groups[8];
+	memcpy(groups, &flags, sizeof(groups));
+	uint64_t mask = 0;
+	for ( int i = 0; i < 8; ++i )  mask |= (groups[i] * 0x0102040810204080) >> 56 << (8 * i);
+	return mask;
+}
+
+inline bool IsSpace(char c)  // The same set, one character
+{
+	return c == ' ' || static_cast<uint8_t>(c - '\t') < 5;
+}
+
+
+
+// Words of a file or a pipe as string_views into the input itself. A
+// regular file is memory-mapped, and its words stay valid while the source
+// lives. Anything else (or map = false) is read() in large chunks; then a
+// word is valid until the next call of Next().
+class WordSource
+{
+public:
+	explicit WordSource(const char* path, bool map = true);
+	explicit WordSource(int fd, bool map = true);  // The descriptor is not closed
+	explicit WordSource(string_view text);          // Text in memory
+	WordSource(const WordSource&) = delete;
+	WordSource& operator =(const WordSource&) = delete;
+	~WordSource();
+
+	bool Mapped() const { return map_ != nullptr; }
+	// The whole input when it is mapped or in memory, else empty
+	string_view Text() const { return buffer_.empty() ? string_view(data_, size_) : string_view(); }
+	string_view Next();  // Empty at the end of input
+
+	class Iterator;
+	Iterator begin();
+	Iterator end();
+
+private:
+	static constexpr size_t block = sizeof(Bytes);
+	static constexpr size_t chunk = 1 << 20;
+
+	int fd_ = -1;
+	bool own_fd_ = false;
+	void* map_ = nullptr;
+	size_t map_size_ = 0;
+	vector<char> buffer_;  // For read()
+	bool eof_ = false;
+
+	const char* data_ = nullptr;  // The mapped file or the buffered part of the input
+	size_t size_ = 0;
+	size_t next_ = 0;             // The next block to scan
+	size_t base_ = 0;             // The block of 'boundaries_'
+	uint64_t boundaries_ = 0;     // Word starts and ends not yet consumed
+	bool prev_space_ = true;
+	bool in_word_ = false;
+	size_t word_begin_ = 0;
+
+	void Open(bool map);
+	void Scan(const char* p, size_t pos);
+	void Refill();
+};
+
+
+
+WordSource::WordSource(const char* path, bool map)
+	: fd_ {open(path, O_RDONLY)}, own_fd_ {true}
+{
+	if ( fd_ < 0 )  throw runtime_error("WordSource: cannot open "s + path);
+	Open(map);
+}
+
+
+
+WordSource::WordSource(int fd, bool map) : fd_ {fd}
+{
+	Open(map);
+}
+
+
+
+WordSource::WordSource(string_view text)
+	: eof_ {true}, data_ {text.data()}, size_ {text.size()}
+{
+}
+
+
+
+// A regular file is mapped from the current offset of the descriptor on
+void WordSource::Open(bool map)
+{
+	struct stat st;
+	const off_t offset = lseek(fd_, 0, SEEK_CUR);
+	if ( map && fstat(fd_, &st) == 0 && S_ISREG(st.st_mode) && offset >= 0 && st.st_size > offset )
+	{
+		void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd_, 0);
+		if ( p != MAP_FAILED )
+		{
+			madvise(p, st.st_size, MADV_SEQUENTIAL);
+			map_ = p;
+			map_size_ = st.st_size;
+			data_ = static_cast<const char*>(p) + offset;
+			size_ = st.st_size - offset;
+			eof_ = true;
+			return;
+		}
+	}
+	buffer_.resize(chunk);
+	data_ = buffer_.data();
+}
+
+
+
+WordSource::~WordSource()
+{
+	if ( map_ )  munmap(map_, map_size_);
+	if ( own_fd_ )  close(fd_);
+}
+
+
+
+// Word boundaries are the bits where a space follows a non-space or the
+// other way round, i.e. where the space mask differs from itself shifted.
+inline void WordSource::Scan(const char* p, size_t pos)
+{
+	const uint64_t spaces = SpaceMask(p);
+	boundaries_ = spaces ^ ((spaces << 1) | prev_space_);
+	prev_space_ = spaces >> 63;
+	base_ = pos;
+}
+
+
+
+inline string_view WordSource::Next()
+{
+	for ( ;; )
+	{
+		while ( boundaries_ )
+		{
+			const size_t pos = base_ + countr_zero(boundaries_);
+			boundaries_ &= boundaries_ - 1;
+			in_word_ = !in_word_;
+			if ( in_word_ )  word_begin_ = pos;
+			else  return {data_ + word_begin_, pos - word_begin_};
+		}
+		if ( next_ + block <= size_ )
+		{
+			Scan(data_ + next_, next_);
+			next_ += block;
+		}
+		else if ( !eof_ )
+			Refill();
+		else if ( next_ < size_ )  // The last partial block, padded with spaces
+		{
+			char tail[block];
+			memset(tail, ' ', block);
+			memcpy(tail, data_ + next_, size_ - next_);
+			Scan(tail, next_);
+			next_ = size_;
+		}
+		else if ( in_word_ )  // A word up to the very end
+		{
+			in_word_ = false;
+			return {data_ + word_begin_, size_ - word_begin_};
+		}
+		else
+			return {};
+	}
+}
+
+
+
+// Moves the unfinished word and the unscanned bytes to the front of the
+// buffer and reads more after them. A word longer than the buffer doubles it.
+void WordSource::Refill()
+{
+	const size_t keep_from = in_word_ ? min(word_begin_, next_) : next_;
+	const size_t kept = size_ - keep_from;
+	memmove(buffer_.data(), buffer_.data() + keep_from, kept);
+	word_begin_ -= in_word_ ? keep_from : 0;
+	next_ -= keep_from;
+	size_ = kept;
+	if ( buffer_.size() - size_ < chunk / 2 )  buffer_.resize(2 * buffer_.size());
+	data_ = buffer_.data();
+	for ( ;; )
+	{
+		const ssize_t n = read(fd_, buffer_.data() + size_, buffer_.size() - size_);
+		if ( n > 0 )  { size_ += n; return; }
+		if ( n == 0 )  { eof_ = true; return; }
+		if ( errno != EINTR )  throw runtime_error("WordSource: read error");
+	}
+}
+
+
+
+// An input iterator, so that a source works where istream_iterator does
+class WordSource::Iterator
+{
+public:
+	using iterator_category = input_iterator_tag;
+	using value_type = string_view;
+	using difference_type = ptrdiff_t;
+	using pointer = const string_view*;
+	using reference = const string_view&;
+
+	Iterator() = default;
+	explicit Iterator(WordSource* source) : source_ {source} { ++*this; }
+
+	reference operator *() const { return word_; }
+	pointer operator ->() const { return &word_; }
+	Iterator& operator ++()
+	{
+		word_ = source_->Next();
+		if ( word_.empty() )  source_ = nullptr;
+		return *this;
+	}
+	void operator ++(int) { ++*this; }
+	bool operator ==(const Iterator& other) const { return source_ == other.source_; }
+
+private:
+	WordSource* source_ = nullptr;
+	string_view word_;
+};
+
+WordSource::Iterator WordSource::begin() { return Iterator(this); }
+WordSource::Iterator WordSource::end() { return Iterator(); }
+
+
+
+//-----------------------------------------------------------------------------
+
+
+// A word with its first 8 bytes as a big-endian number (zero-padded), so
+// that comparing the keys compares the words up to their 8th byte.
+struct KeyedWord
+{
+	uint64_t key;
+	string_view word;
+};
+
+inline uint64_t PrefixKey(string_view w)
+{
+	uint64_t key = 0;
+	for ( size_t i = 0; i < 8; ++i )
+		key = key << 8 | (i < w.size() ? static_cast<uint8_t>(w[i]) : 0);
+	return key;
+}
+
+inline bool operator <(const KeyedWord& lhs, const KeyedWord& rhs)
+{
+	return lhs.key != rhs.key ? lhs.key < rhs.key : lhs.word < rhs.word;
+}
+
+
+
+// MSD radix sort by the key bytes from the most significant one. Small
+// buckets, and buckets whose keys are all equal, are finished by
+// comparisons, which then rarely need to look at the words themselves.
+void RadixSort(KeyedWord* first, KeyedWord* last, KeyedWord* buffer, int byte = 7)
+{
+	const size_t n = last - first;
+	if ( n < 64 || byte < 0 )  { sort(first, last); return; }
+	const int shift = 8 * byte;
+	size_t begin[257] = {};
+	for ( KeyedWord* p = first; p != last; ++p )  ++begin[(p->key >> shift & 0xff) + 1];
+	if ( begin[(first->key >> shift & 0xff) + 1] == n )  // One bucket, e.g. a repeated word
+	{
+		RadixSort(first, last, buffer, byte - 1);
+		return;
+	}
+	for ( int b = 0; b < 256; ++b )  begin[b + 1] += begin[b];
+	size_t pos[256];
+	copy(begin, begin + 256, pos);
+	for ( KeyedWord* p = first; p != last; ++p )  buffer[pos[p->key >> shift & 0xff]++] = *p;
+	copy(buffer, buffer + n, first);
+	for ( int b = 0; b < 256; ++b )
+		if ( begin[b + 1] - begin[b] > 1 )
+			RadixSort(first + begin[b], first + begin[b + 1], buffer + begin[b], byte - 1);
+}
+
+
+
+// Splits 'text' into about 'parts' pieces at whitespace
+vector<string_view> SplitText(string_view text, size_t parts)
+{
+	vector<string_view> pieces;
+	size_t begin = 0;
+	for ( size_t i = 1; i <= parts && begin < text.size(); ++i )
+	{
+		size_t end = (i == parts) ? text.size() : max(begin, text.size() * i / parts);
+		while ( end < text.size() && !IsSpace(text[end]) )  ++end;
+		pieces.push_back(text.substr(begin, end - begin));
+		begin = end;
+	}
+	return pieces;
+}
+
+
+
+// Sorted distinct words of 'text' on one thread. Words are sorted and
+// deduplicated in batches that fit in L2, which removes most repetitions
+// early. The batches are kept on a stack and merged by set_union() whenever
+// the top one has grown to about the size of the one below, so that every
+// word takes part in O(log n) merges.
+vector<string_view> SortUniquePiece(string_view text)
+{
+	constexpr size_t batch = 1 << 17;
+	vector<KeyedWord> keyed, buffer(batch);
+	vector<vector<KeyedWord>> runs;  // Merging compares the keys first as well
+	keyed.reserve(batch);
+	auto merge_top = [&]
+	{
+		auto b = move(runs.back());
+		runs.pop_back();
+		auto& a = runs.back();
+		vector<KeyedWord> merged;
+		merged.reserve(a.size() + b.size());
+		set_union(a.begin(), a.end(), b.begin(), b.end(), back_inserter(merged));
+		a = move(merged);
+	};
+	WordSource source(text);
+	for ( string_view w = source.Next(); ; w = source.Next() )
+	{
+		if ( !w.empty() )  keyed.push_back({PrefixKey(w), w});
+		if ( keyed.size() < batch && !w.empty() )  continue;
+		RadixSort(keyed.data(), keyed.data() + keyed.size(), buffer.data());
+		auto& run = runs.emplace_back();
+		for ( size_t j = 0; j < keyed.size(); ++j )
+			if ( j == 0 || keyed[j].word != keyed[j - 1].word )  run.push_back(keyed[j]);
+		keyed.clear();
+		while ( runs.size() > 1 && runs[runs.size() - 2].size() <= 2 * runs.back().size() )  merge_top();
+		if ( w.empty() )  break;
+	}
+	while ( runs.size() > 1 )  merge_top();
+	vector<string_view> words(runs[0].size());
+	for ( size_t i = 0; i < words.size(); ++i )  words[i] = runs[0][i].word;
+	return words;
+}
+
+
+
+// A tree of losers for a k-way merge (Knuth, vol. 3, 5.4.1). Leaf i holds
+// the current word of input i, an empty word once the input is exhausted.
+// Every inner node keeps the loser of the match played there and node 0
+// the overall winner, so replacing the winner's word replays only the
+// matches on its path: log2(k) comparisons.
+class LoserTree
+{
+public:
+	explicit LoserTree(vector<string_view> words);
+
+	bool Empty() const { return words_[tree_[0]].empty(); }
+	size_t Winner() const { return tree_[0]; }
+	string_view Top() const { return words_[tree_[0]]; }
+	void ReplaceTop(string_view word);
+
+private:
+	vector<string_view> words_;
+	vector<size_t> tree_;  // Inner nodes 1..k-1; leaf i is node k + i
+
+	bool Less(size_t a, size_t b) const  // Exhausted inputs lose, ties go by index
+	{
+		if ( words_[a].empty() || words_[b].empty() )
+			return !words_[a].empty() || (words_[b].empty() && a < b);
+		const int c = words_[a].compare(words_[b]);
+		return c < 0 || (c == 0 && a < b);
+	}
+	size_t Build(size_t node);
+};
+
+
+
+LoserTree::LoserTree(vector<string_view> words)
+	: words_ {move(words)}, tree_(max<size_t>(words_.size(), 1))
+{
+	if ( words_.empty() )  words_.emplace_back();
+	tree_[0] = Build(1);
+}
+
+
+
+size_t LoserTree::Build(size_t node)
+{
+	const size_t k = words_.size();
+	if ( node >= k )  return node - k;
+	const size_t a = Build(2 * node), b = Build(2 * node + 1);
+	const bool a_wins = Less(a, b);
+	tree_[node] = a_wins ? b : a;
+	return a_wins ? a : b;
+}
+
+
+
+void LoserTree::ReplaceTop(string_view word)
+{
+	size_t winner = tree_[0];
+	words_[winner] = word;
+	for ( size_t node = (winner + words_.size()) / 2; node > 0; node /= 2 )
+		if ( Less(tree_[node], winner) )  swap(tree_[node], winner);
+	tree_[0] = winner;
+}
+
+
+
+// Sorted distinct words, the same as sort() and unique() of Func1. Every
+// thread takes its own piece of the text; the sorted pieces are then merged
+// in one pass through a loser tree, which drops the words that several
+// pieces have in common.
+vector<string_view> SortedUniqueWords(string_view text,
+                                      unsigned threads = thread::hardware_concurrency())
+{
+	threads = max(1u, threads);
+	const vector<string_view> pieces = SplitText(text, threads);
+	vector<vector<string_view>> parts(pieces.size());
+	vector<thread> pool;
+	for ( size_t i = 0; i < pieces.size(); ++i )
+		pool.emplace_back([&, i]{ parts[i] = SortUniquePiece(pieces[i]); });
+	for ( auto& thr : pool )  thr.join();
+
+	size_t total = 0;
+	vector<string_view> heads(parts.size());
+	for ( size_t i = 0; i < parts.size(); ++i )
+	{
+		total += parts[i].size();
+		if ( !parts[i].empty() )  heads[i] = parts[i][0];
+	}
+	vector<string_view> words;
+	words.reserve(total);
+	vector<size_t> next(parts.size(), 1);
+	for ( LoserTree tree(move(heads)); !tree.Empty(); )
+	{
+		if ( words.empty() || words.back() != tree.Top() )  words.push_back(tree.Top());
+		const size_t i = tree.Winner();
+		tree.ReplaceTop(next[i] < parts[i].size() ? parts[i][next[i]++] : string_view {});
+	}
+	return words;
+}
+
+
+
+// The output of Func1
+template <typename Range>
+void WriteWords(const Range& words, ostream& out)
+{
+	copy(words.begin(), words.end(), ostream_iterator<string_view> {out, ", "});
+}
+
+
+
+//-----------------------------------------------------------------------------
+
+
+// Sorted distinct words of an input of any size in bounded memory. Words
+// are copied into an arena; when the arena or the index is full, they are
+// sorted, deduplicated and spilled to a temporary file (a run) with one
+// word per line. Runs are read back by WordSource, which splits at any
+// whitespace and skips empty lines, so Add() rejects such words.
+// Finish() frees the sorting buffers and merges the runs with a loser tree.
+// Each run being merged costs a 1 MB read buffer and the merged output
+// another, so at most budget / 1 MB - 1 runs are merged at once; if there
+// are more, groups of them are first merged into longer runs.
+class ExternalSortUnique
+{
+public:
+	explicit ExternalSortUnique(size_t memory_budget,
+	                            const filesystem::path& temp_dir = filesystem::temp_directory_path());
+	ExternalSortUnique(const ExternalSortUnique&) = delete;
+	ExternalSortUnique& operator =(const ExternalSortUnique&) = delete;
+	~ExternalSortUnique();
+
+	void Add(string_view word);
+	template <typename OutputIt> OutputIt Finish(OutputIt out);  // *out++ = string_view
+	size_t Runs() const { return runs_created_; }
+
+private:
+	static constexpr size_t io_size = 1 << 20;  // A file buffer, as WordSource's
+
+	size_t arena_bytes_;
+	vector<char> arena_;
+	vector<KeyedWord> keyed_;
+	vector<KeyedWord> buffer_;  // For RadixSort()
+	filesystem::path temp_dir_;
+	deque<filesystem::path> runs_;
+	size_t runs_created_ = 0;
+	size_t fan_in_;
+
+	void Reserve();
+	void Release();
+	void Spill();
+	filesystem::path NewRun();
+	template <typename OutputIt> OutputIt Merge(size_t count, OutputIt out);
+};
+
+
+
+// The buffer of the run being written takes 1 MB of the budget; of the
+// rest, half is for the bytes of the words and a quarter for each of the
+// index and its sorting buffer
+ExternalSortUnique::ExternalSortUnique(size_t memory_budget, const filesystem::path& temp_dir)
+	: arena_bytes_ {(max(memory_budget, io_size) - io_size) / 2}, temp_dir_ {temp_dir},
+	  fan_in_ {clamp<size_t>(memory_budget / io_size - 1, 2, 1000)}
+{
+	if ( memory_budget < 3 * io_size )
+		throw invalid_argument("ExternalSortUnique: budget below 3 MB");
+	Reserve();
+}
+
+
+
+void ExternalSortUnique::Reserve()
+{
+	arena_.reserve(arena_bytes_);
+	keyed_.reserve(arena_bytes_ / 2 / sizeof(KeyedWord));
+	buffer_.resize(keyed_.capacity());
+}
+
+
+
+// clear() would keep the capacity
+void ExternalSortUnique::Release()
+{
+	vector<char>().swap(arena_);
+	vector<KeyedWord>().swap(keyed_);
+	vector<KeyedWord>().swap(buffer_);
+}
+
+
+
+ExternalSortUnique::~ExternalSortUnique()
+{
+	for ( const auto& run : runs_ )  filesystem::remove(run);
+}
+
+
+
+// The arena never reallocates, so the views of 'keyed_' stay valid.
+void ExternalSortUnique::Add(string_view word)
+{
+	if ( word.empty() || any_of(word.begin(), word.end(), IsSpace) )
+		throw invalid_argument("ExternalSortUnique: empty word or whitespace in a word");
+	if ( word.size() > arena_bytes_ )
+		throw length_error("ExternalSortUnique: word is longer than the budget");
+	if ( arena_.size() + word.size() > arena_.capacity() || keyed_.size() == keyed_.capacity() )
+	{
+		Spill();
+		Reserve();  // Again after Finish()
+	}
+	const size_t at = arena_.size();
+	arena_.insert(arena_.end(), word.begin(), word.end());
+	keyed_.push_back({PrefixKey(word), {arena_.data() + at, word.size()}});
+}
+
+
+
+// The number is counted over the process, so that several sorters may
+// share a directory
+filesystem::path ExternalSortUnique::NewRun()
+{
+	static atomic<size_t> next_run = 0;
+	++runs_created_;
+	return runs_.emplace_back(temp_dir_ / ("words_" + to_string(getpid()) + '_'
+	                                       + to_string(next_run++) + ".run"));
+}
+
+
+
+void ExternalSortUnique::Spill()
+{
+	if ( keyed_.empty() )  return;
+	RadixSort(keyed_.data(), keyed_.data() + keyed_.size(), buffer_.data());
+	vector<char> io_buffer(io_size);
+	ofstream out;
+	out.rdbuf()->pubsetbuf(io_buffer.data(), io_buffer.size());  // Before open()
+	out.open(NewRun(), ios::binary);
+	for ( size_t i = 0; i < keyed_.size(); ++i )
+		if ( i == 0 || keyed_[i].word != keyed_[i - 1].word )
+			out.write(keyed_[i].word.data(), keyed_[i].word.size()).put('\n');
+	if ( !out.flush() )  throw runtime_error("ExternalSortUnique: cannot write a run");
+	arena_.clear();
+	keyed_.clear();
+}
+
+
+
+// Merges the first 'count' runs, removing them. The last word written is
+// kept as a copy, since its view dies when its run reads on.
+template <typename OutputIt>
+OutputIt ExternalSortUnique::Merge(size_t count, OutputIt out)
+{
+	vector<unique_ptr<WordSource>> sources;
+	vector<string_view> first;
+	for ( size_t i = 0; i < count; ++i )
+	{
+		sources.push_back(make_unique<WordSource>(runs_[i].c_str(), false));
+		first.push_back(sources.back()->Next());
+	}
+	LoserTree tree(move(first));
+	string last;
+	bool any = false;
+	for ( ; !tree.Empty(); tree.ReplaceTop(sources[tree.Winner()]->Next()) )
+	{
+		const string_view word = tree.Top();
+		if ( any && word == last )  continue;
+		*out++ = word;
+		last.assign(word);
+		any = true;
+	}
+	sources.clear();
+	for ( size_t i = 0; i < count; ++i )
+	{
+		filesystem::remove(runs_.front());
+		runs_.pop_front();
+	}
+	return out;
+}
+
+
+
+// Writes a merged run as a sink for Merge()
+struct RunWriter
+{
+	ofstream* out;
+	RunWriter& operator *() { return *this; }
+	RunWriter& operator ++(int) { return *this; }
+	RunWriter& operator =(string_view word)
+	{
+		out->write(word.data(), word.size()).put('\n');
+		return *this;
+	}
+};
+
+
+
+template <typename OutputIt>
+OutputIt ExternalSortUnique::Finish(OutputIt out)
+{
+	if ( runs_.empty() )  // Everything fits in memory
+	{
+		RadixSort(keyed_.data(), keyed_.data() + keyed_.size(), buffer_.data());
+		for ( size_t i = 0; i < keyed_.size(); ++i )
+			if ( i == 0 || keyed_[i].word != keyed_[i - 1].word )  *out++ = keyed_[i].word;
+		Release();
+		return out;
+	}
+	Spill();
+	Release();
+	while ( runs_.size() > fan_in_ )
+	{
+		vector<char> io_buffer(io_size);
+		ofstream run;
+		run.rdbuf()->pubsetbuf(io_buffer.data(), io_buffer.size());
+		run.open(NewRun(), ios::binary);  // Goes to the back of the queue
+		Merge(fan_in_, RunWriter {&run});
+		if ( !run.flush() )  throw runtime_error("ExternalSortUnique: cannot write a run");
+	}
+	return Merge(runs_.size(), out);
+}
+
+
+
+//-----------------------------------------------------------------------------
+
+
+// Multiply-xorshift over 8 bytes at a time
+inline uint64_t HashWord(string_view s)
+{
+	uint64_t h = s.size() * 0x9e3779b97f4a7c15;
+	size_t i = 0;
+	for ( ; i + 8 <= s.size(); i += 8 )
+	{
+		uint64_t v;
+		memcpy(&v, s.data() + i, 8);
+		h = (h ^ v) * 0xbf58476d1ce4e5b9;
+		h ^= h >> 31;
+	}
+	if ( i < s.size() )
+	{
+		uint64_t v = 0;
+		memcpy(&v, s.data() + i, s.size() - i);
+		h = (h ^ v) * 0xbf58476d1ce4e5b9;
+	}
+	h = (h ^ (h >> 29)) * 0x94d049bb133111eb;
+	return h ^ (h >> 32);
+}
+
+
+
+// Distinct strings stored once, one after another in 1 MB blocks, each
+// with a 4-byte length before it, and found through an open-addressing
+// hash index. Ids are 32-bit and dense, and both ids and string_views stay
+// valid while the interner lives. A repeated string costs one hash lookup
+// and no allocation; a new one costs its bytes plus about 20 bytes of index.
+class StringInterner
+{
+public:
+	static constexpr uint32_t npos = UINT32_MAX;
+
+	StringInterner() : slots_(1024) {}
+
+	uint32_t Intern(string_view s);
+	uint32_t Find(string_view s) const;  // npos if absent
+	string_view operator [](uint32_t id) const { return View(strings_[id]); }
+	size_t size() const { return strings_.size(); }
+	size_t MemoryBytes() const;
+	template <typename OutputIt> OutputIt CopySorted(OutputIt out) const;
+
+private:
+	struct Slot
+	{
+		uint32_t id = npos;
+		uint32_t hash;  // Also gives the position, so growing needs no rehashing of the strings
+	};
+	static constexpr size_t block_size = 1 << 20;
+
+	vector<unique_ptr<char[]>> blocks_;
+	size_t block_used_ = block_size;
+	size_t block_bytes_ = 0;
+	vector<const char*> strings_;  // By id
+	vector<Slot> slots_;           // Size is a power of two, at most 70% used
+
+	static string_view View(const char* p)
+	{
+		uint32_t size;
+		memcpy(&size, p, sizeof(size));
+		return {p + sizeof(size), size};
+	}
+	size_t Probe(string_view s, uint32_t hash) const;  // The slot of s or the empty one to take
+	const char* Store(string_view s);
+	void Grow();
+};
+
+
+
+size_t StringInterner::Probe(string_view s, uint32_t hash) const
+{
+	const size_t mask = slots_.size() - 1;
+	for ( size_t i = hash & mask; ; i = (i + 1) & mask )
+	{
+		const Slot& slot = slots_[i];
+		if ( slot.id == npos || (slot.hash == hash && View(strings_[slot.id]) == s) )  return i;
+	}
+}
+
+
+
+uint32_t StringInterner::Intern(string_view s)
+{
+	const uint32_t hash = static_cast<uint32_t>(HashWord(s));
+	size_t i = Probe(s, hash);
+	if ( slots_[i].id != npos )  return slots_[i].id;
+	if ( strings_.size() >= npos - 1 || s.size() > UINT32_MAX )
+		throw length_error("StringInterner: too many strings or too long");
+	if ( (strings_.size() + 1) * 10 > slots_.size() * 7 )
+	{
+		Grow();
+		i = Probe(s, hash);
+	}
+	const uint32_t id = static_cast<uint32_t>(strings_.size());
+	strings_.push_back(Store(s));
+	slots_[i] = {id, hash};
+	return id;
+}
+
+
+
+uint32_t StringInterner::Find(string_view s) const
+{
+	return slots_[Probe(s, static_cast<uint32_t>(HashWord(s)))].id;
+}
+
+
+
+// A string longer than a block gets a block of its own
+const char* StringInterner::Store(string_view s)
+{
+	const uint32_t size = static_cast<uint32_t>(s.size());
+	const size_t need = sizeof(size) + s.size();
+	if ( block_used_ + need > block_size )
+	{
+		blocks_.push_back(make_unique_for_overwrite<char[]>(max(block_size, need)));
+		block_bytes_ += max(block_size, need);
+		block_used_ = 0;
+	}
+	char* p = blocks_.back().get() + block_used_;
+	memcpy(p, &size, sizeof(size));
+	memcpy(p + sizeof(size), s.data(), s.size());
+	block_used_ = (need > block_size) ? block_size : block_used_ + need;
+	return p;
+}
+
+
+
+void StringInterner::Grow()
+{
+	vector<Slot> slots(2 * slots_.size());
+	const size_t mask = slots.size() - 1;
+	for ( const Slot& slot : slots_ )
+		if ( slot.id != npos )
+		{
+			size_t i = slot.hash & mask;
+			while ( slots[i].id != npos )  i = (i + 1) & mask;
+			slots[i] = slot;
+		}
+	slots_ = move(slots);
+}
+
+
+
+size_t StringInterner::MemoryBytes() const
+{
+	return block_bytes_ + strings_.capacity() * sizeof(const char*) + slots_.size() * sizeof(Slot);
+}
+
+
+
+// Sorted export with the radix sort of SortedUniqueWords()
+template <typename OutputIt>
+OutputIt StringInterner::CopySorted(OutputIt out) const
+{
+	vector<KeyedWord> keyed(strings_.size()), buffer(strings_.size());
+	for ( size_t id = 0; id < strings_.size(); ++id )
+	{
+		const string_view s = View(strings_[id]);
+		keyed[id] = {PrefixKey(s), s};
+	}
+	RadixSort(keyed.data(), keyed.data() + keyed.size(), buffer.data());
+	for ( const auto& k : keyed )  *out++ = k.word;
+	return out;
+}
+
+
+
+//-----------------------------------------------------------------------------
+
+
+// Output to a file descriptor through one large buffer that is written
+// with write(2) when full: no formatting, locale, sentry or stdio locking
+// per value. A string too large to be worth copying is sent together with
+// the buffered bytes in one writev(2) call instead.
+class FdSink
+{
+public:
+	explicit FdSink(int fd, size_t buffer_size = 1 << 20) : fd_ {fd}, buffer_(buffer_size) {}
+	FdSink(const FdSink&) = delete;
+	FdSink& operator =(const FdSink&) = delete;
+	~FdSink();
+
+	void Write(string_view s)
+	{
+		if ( s.size() <= buffer_.size() - used_ )
+		{
+			memcpy(buffer_.data() + used_, s.data(), s.size());
+			used_ += s.size();
+		}
+		else
+			WriteSlow(s);
+	}
+	void Flush();
+
+private:
+	int fd_;
+	vector<char> buffer_;
+	size_t used_ = 0;
+
+	void WriteSlow(string_view s);
+	void WriteAll(iovec* iov, int count);
+};
+
+
+
+FdSink::~FdSink()
+{
+	try { Flush(); }
+	catch ( const runtime_error& ) {}  // Call Flush() first to see errors
+}
+
+
+
+void FdSink::Flush()
+{
+	iovec iov {buffer_.data(), used_};
+	used_ = 0;
+	WriteAll(&iov, 1);
+}
+
+
+
+void FdSink::WriteSlow(string_view s)
+{
+	if ( s.size() < buffer_.size() / 2 )  // Flush and copy
+	{
+		Flush();
+		Write(s);
+		return;
+	}
+	iovec iov[2] = {{buffer_.data(), used_}, {const_cast<char*>(s.data()), s.size()}};
+	used_ = 0;
+	WriteAll(iov, 2);
+}
+
+
+
+// write(2) may write less than asked, e.g. to a pipe, or be interrupted
+void FdSink::WriteAll(iovec* iov, int count)
+{
+	while ( count > 0 )
+	{
+		if ( iov->iov_len == 0 )  { ++iov; --count; continue; }
+		const ssize_t n = writev(fd_, iov, count);
+		if ( n < 0 )
+		{
+			if ( errno == EINTR )  continue;
+			throw runtime_error("FdSink: write error");
+		}
+		for ( size_t done = n; done > 0; )
+		{
+			const size_t part = min(done, iov->iov_len);
+			iov->iov_base = static_cast<char*>(iov->iov_base) + part;
+			iov->iov_len -= part;
+			done -= part;
+			if ( iov->iov_len == 0 )  { ++iov; --count; }
+		}
+	}
+}
+
+
+
+// An output iterator like ostream_iterator<string>(out, delimiter), so it
+// can replace one in copy(), unique_copy() and the like.
+class SinkIterator
+{
+public:
+	using iterator_category = output_iterator_tag;
+	using value_type = void;
+	using difference_type = ptrdiff_t;
+	using pointer = void;
+	using reference = void;
+
+	explicit SinkIterator(FdSink& sink, const char* delimiter = "")
+		: sink_ {&sink}, delimiter_ {delimiter} {}
+
+	SinkIterator& operator =(string_view s)
+	{
+		sink_->Write(s);
+		if ( !delimiter_.empty() )  sink_->Write(delimiter_);
+		return *this;
+	}
+	SinkIterator& operator *() { return *this; }
+	SinkIterator& operator ++() { return *this; }
+	SinkIterator& operator ++(int) { return *this; }
+
+private:
+	FdSink* sink_;
+	string_view delimiter_;
+};
+
+
+
+//-----------------------------------------------------------------------------
+
+
+struct WordCount
+{
+	string_view word;
+	uint64_t count;
+};
+
+inline bool MoreFrequent(const WordCount& lhs, const WordCount& rhs)  // Ties by word
+{
+	return lhs.count != rhs.count ? lhs.count > rhs.count : lhs.word < rhs.word;
+}
+
+
+
+// Exact word frequencies: a StringInterner gives every distinct word an id
+// (through its open-addressing index) and the counts are a plain array
+// indexed by id. The words are owned, so any input source will do.
+class WordCounter
+{
+public:
+	void Add(string_view word, uint64_t count = 1)
+	{
+		const uint32_t id = words_.Intern(word);
+		if ( id == counts_.size() )  counts_.push_back(0);
+		counts_[id] += count;
+	}
+	WordCounter& operator +=(const WordCounter& other);
+
+	size_t size() const { return counts_.size(); }
+	size_t MemoryBytes() const { return words_.MemoryBytes() + counts_.capacity() * sizeof(uint64_t); }
+	vector<WordCount> Top(size_t k) const;
+
+private:
+	StringInterner words_;
+	vector<uint64_t> counts_;
+};
+
+
+
+WordCounter& WordCounter::operator +=(const WordCounter& other)
+{
+	for ( uint32_t id = 0; id < other.counts_.size(); ++id )  Add(other.words_[id], other.counts_[id]);
+	return *this;
+}
+
+
+
+vector<WordCount> WordCounter::Top(size_t k) const
+{
+	vector<WordCount> all(counts_.size());
+	for ( uint32_t id = 0; id < counts_.size(); ++id )  all[id] = {words_[id], counts_[id]};
+	k = min(k, all.size());
+	partial_sort(all.begin(), all.begin() + k, all.end(), MoreFrequent);
+	all.resize(k);
+	return all;
+}
+
+
+
+// Every thread counts its own piece of the text into its own table; the
+// tables are then added up.
+WordCounter CountWords(string_view text, unsigned threads = thread::hardware_concurrency())
+{
+	const vector<string_view> pieces = SplitText(text, max(1u, threads));
+	vector<WordCounter> counters(pieces.size());
+	vector<thread> pool;
+	for ( size_t i = 0; i < pieces.size(); ++i )
+		pool.emplace_back([&, i]
+		{
+			WordSource source(pieces[i]);
+			for ( string_view w = source.Next(); !w.empty(); w = source.Next() )  counters[i].Add(w);
+		});
+	for ( auto& thr : pool )  thr.join();
+	WordCounter total;
+	for ( const auto& c : counters )  total += c;
+	return total;
+}
+
+
+
+// Approximate heavy hitters in fixed memory. A count-min sketch (Cormode
+// and Muthukrishnan) estimates the count of any word from 'depth' rows of
+// 'width' counters and never underestimates; with conservative update the
+// overestimate stays small for frequent words. The k words with the
+// largest estimates are kept, with their own copies of the words, in a
+// min-heap, so a word that overtakes the smallest one replaces it.
+class HeavyHitters
+{
+public:
+	HeavyHitters(size_t k, size_t width = 1 << 18, size_t depth = 4);
+
+	void Add(string_view word);
+	size_t MemoryBytes() const;
+	vector<WordCount> Top() const;
+
+private:
+	struct Candidate
+	{
+		string word;
+		uint64_t count;
+		size_t heap_pos;
+	};
+
+	static constexpr size_t max_depth = 16;
+	size_t width_;
+	size_t depth_;
+	vector<uint32_t> sketch_;   // depth_ rows of width_ counters
+	vector<Candidate> candidates_;  // k slots; never reallocated, so the views of index_ stay valid
+	vector<uint32_t> heap_;     // Slots of candidates_, smallest count first
+	unordered_map<string_view, uint32_t> index_;  // Word -> slot
+
+	uint64_t Update(uint64_t hash);
+	void SiftDown(size_t pos);
+	void Place(size_t pos, uint32_t slot)
+	{
+		heap_[pos] = slot;
+		candidates_[slot].heap_pos = pos;
+	}
+};
+
+
+
+HeavyHitters::HeavyHitters(size_t k, size_t width, size_t depth)
+	: width_ {width}, depth_ {depth}, sketch_(width * depth)
+{
+	if ( k == 0 || width == 0 || depth == 0 )  throw invalid_argument("HeavyHitters: zero size");
+	if ( depth > max_depth )  throw invalid_argument("HeavyHitters: too many rows");
+	candidates_.reserve(k);
+	heap_.reserve(k);
+}
+
+
+
+// Row i uses the hash h1 + i h2 (Kirsch and Mitzenmacher). Only the rows
+// whose counter equals the minimum are incremented: the conservative
+// update. Returns the new estimate.
+uint64_t HeavyHitters::Update(uint64_t hash)
+{
+	const uint64_t h1 = hash, h2 = (hash >> 32) | 1;
+	uint32_t* cell[max_depth];
+	uint32_t estimate = UINT32_MAX;
+	for ( size_t i = 0; i < depth_; ++i )
+	{
+		cell[i] = &sketch_[i * width_ + (h1 + i * h2) % width_];
+		estimate = min(estimate, *cell[i]);
+	}
+	if ( estimate == UINT32_MAX )  return estimate;  // Saturated
+	for ( size_t i = 0; i < depth_; ++i )
+		if ( *cell[i] == estimate )  ++*cell[i];
+	return estimate + 1;
+}
+
+
+
+void HeavyHitters::SiftDown(size_t pos)
+{
+	const uint32_t slot = heap_[pos];
+	for ( ;; )
+	{
+		size_t child = 2 * pos + 1;
+		if ( child >= heap_.size() )  break;
+		if ( child + 1 < heap_.size()
+		     && candidates_[heap_[child + 1]].count < candidates_[heap_[child]].count )  ++child;
+		if ( candidates_[heap_[child]].count >= candidates_[slot].count )  break;
+		Place(pos, heap_[child]);
+		pos = child;
+	}
+	Place(pos, slot);
+}
+
+
+
+void HeavyHitters::Add(string_view word)
+{
+	const uint64_t estimate = Update(HashWord(word));
+	if ( const auto it = index_.find(word); it != index_.end() )
+	{
+		Candidate& c = candidates_[it->second];
+		c.count = estimate;  // Only grows, so it moves down the min-heap
+		SiftDown(c.heap_pos);
+		return;
+	}
+	if ( candidates_.size() < candidates_.capacity() )
+	{
+		const uint32_t slot = static_cast<uint32_t>(candidates_.size());
+		candidates_.push_back({string(word), estimate, 0});
+		heap_.push_back(slot);
+		size_t pos = heap_.size() - 1;
+		for ( ; pos > 0 && candidates_[heap_[(pos - 1) / 2]].count > estimate; pos = (pos - 1) / 2 )
+			Place(pos, heap_[(pos - 1) / 2]);  // Sift up
+		Place(pos, slot);
+		index_.emplace(candidates_[slot].word, slot);
+		return;
+	}
+	const uint32_t slot = heap_[0];
+	Candidate& smallest = candidates_[slot];
+	if ( estimate <= smallest.count )  return;
+	index_.erase(smallest.word);
+	smallest.word.assign(word);
+	smallest.count = estimate;
+	index_.emplace(smallest.word, slot);
+	SiftDown(0);
+}
+
+
+
+size_t HeavyHitters::MemoryBytes() const
+{
+	// A node of the index holds the next pointer, the value and the hash
+	const size_t node = sizeof(void*) + sizeof(pair<const string_view, uint32_t>) + sizeof(size_t);
+	size_t bytes = sketch_.size() * sizeof(uint32_t) + candidates_.capacity() * sizeof(Candidate)
+	               + heap_.capacity() * sizeof(uint32_t)
+	               + index_.bucket_count() * sizeof(void*) + index_.size() * node;
+	for ( const auto& c : candidates_ )  // Long words are outside the string object
+		bytes += c.word.capacity() > string().capacity() ? c.word.capacity() + 1 : 0;
+	return bytes;
+}
+
+
+
+vector<WordCount> HeavyHitters::Top() const
+{
+	vector<WordCount> top;
+	for ( const auto& c : candidates_ )  top.push_back({c.word, c.count});
+	sort(top.begin(), top.end(), MoreFrequent);
+	return top;
+}
+
+
+
+// Writes "word count" items to an output iterator of string_views, such as
+// ostream_iterator<string_view> {cout, "\n"} or a SinkIterator.
+template <typename OutputIt>
+OutputIt CopyCounts(const vector<WordCount>& counts, OutputIt out)
+{
+	string line;
+	for ( const auto& [word, count] : counts )
+	{
+		char digits[24];
+		const auto end = to_chars(digits, digits + sizeof(digits), count).ptr;
+		line.assign(word).append(1, ' ').append(digits, end);
+		*out++ = string_view(line);
+	}
+	return out;
+}
+
+
+
+//-----------------------------------------------------------------------------
+
+
+template <typename F>
+double TimeSec(F f)
+{
+	const auto t = chrono::steady_clock::now();
+	f();
+	return chrono::duration<double>(chrono::steady_clock::now() - t).count();
+}
+
+
+
+// Words of a Zipf-like vocabulary (word k has a probability of about
+// 1 / (k log V)) separated mostly by spaces, sometimes by newlines or tabs.
+class TextGenerator
+{
+public:
+	TextGenerator(size_t vocabulary, unsigned seed) : gen_(seed), words_(vocabulary)
+	{
+		uniform_int_distribution<int> length(1, 12), letter('a', 'z');
+		for ( auto& w : words_ )
+			for ( int n = length(gen_); n > 0; --n )  w += static_cast<char>(letter(gen_));
+	}
+
+	void Append(string& text, size_t bytes)  // At least 'bytes' more
+	{
+		for ( const size_t end = text.size() + bytes; text.size() < end; )
+		{
+			text += words_[static_cast<size_t>(pow(words_.size(), u_(gen_))) - 1];
+			const int s = separator_(gen_);
+			text += s == 0 ? '\n' : (s == 1 ? '\t' : ' ');
+		}
+	}
+
+private:
+	mt19937 gen_;
+	vector<string> words_;
+	uniform_real_distribution<double> u_ {0, 1};
+	uniform_int_distribution<int> separator_ {0, 15};
+};
+
+
+
+string MakeText(size_t bytes, size_t vocabulary, unsigned seed)
+{
+	TextGenerator generator(vocabulary, seed);
+	string text;
+	generator.Append(text, bytes);
+	return text;
+}
+
+
+
+// The same in a temporary file, written in chunks
+// A file name in the temporary directory that no other process or call
+// uses, numbered as the runs of ExternalSortUnique
+string TempPath(const string& stem)
+{
+	static atomic<size_t> next_file = 0;
+	return (filesystem::temp_directory_path() / (stem + '_' + to_string(getpid()) + '_'
+	                                             + to_string(next_file++) + ".txt")).string();
+}
+
+
+
+string MakeCorpus(size_t bytes, size_t vocabulary, unsigned seed)
+{
+	TextGenerator generator(vocabulary, seed);
+	const string path = TempPath("word_processing_corpus");
+	ofstream out(path, ios::binary);
+	string text;
+	for ( size_t written = 0; written < bytes && out; written += text.size() )
+	{
+		text.clear();
+		generator.Append(text, 1 << 20);
+		out.write(text.data(), text.size());
+	}
+	if ( !out.flush() )
+	{
+		filesystem::remove(path);
+		throw runtime_error("MakeCorpus: cannot write " + path);
+	}
+	return path;
+}
+
+
+
+// The benchmarks read their input several times and keep the words of a
+// mapped file, so a pipe or a device is first copied into a regular file
+string CopyInput(const string& input)
+{
+	const string path = TempPath("word_processing_input");
+	ifstream in(input, ios::binary);
+	ofstream out(path, ios::binary);
+	if ( !in || !(out << in.rdbuf()) || !out.flush() )
+	{
+		filesystem::remove(path);
+		throw runtime_error("CopyInput: cannot copy " + input);
+	}
+	return path;
+}
+
+
+
+// The whole input: the mapping itself, or the input read into 'storage'
+// when the file could not be mapped
+string_view WholeText(const string& path, const WordSource& source, string& storage)
+{
+	if ( source.Mapped() )  return source.Text();
+	ifstream in(path, ios::binary);
+	storage.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+	return storage;
+}
+
+
+
+void Report(const char* name, size_t words, size_t bytes, double sec)
+{
+	cout << setw(30) << left << name << right << setw(7) << words / sec / 1e6
+	     << " Mwords/s " << setw(7) << bytes / sec / 1e6 << " MB/s\n";
+}
+
+
+
+void TokenizerDemo(const string& path)
+{
+	WordSource source(path.c_str());
+	cout << "Mapped: " << boolalpha << source.Mapped() << ", first words:";
+	int n = 0;
+	for ( string_view w : source )
+	{
+		cout << ' ' << w;
+		if ( ++n == 10 )  break;
+	}
+	cout << "\n\n";
+}
+
+
+
+void SinkDemo()
+{
+	cout.flush();  // FdSink and cout have separate buffers
+	FdSink sink(STDOUT_FILENO);
+	{
+		SinkIterator oi {sink};
+		*oi = "Hello, ";   // As ostream_iterator<string> {cout}
+		*oi = "world!\n";
+	}
+	const vector<string> words {"to", "be", "or", "not", "to", "be"};
+	unique_copy(words.begin(), words.end(), SinkIterator {sink, ", "});
+	sink.Write("\n\n");
+}
+
+
+
+void TokenizerBenchmark(const string& path)
+{
+	const size_t bytes = filesystem::file_size(path);
+	size_t words[3] = {}, letters[3] = {};
+	double sec = TimeSec([&]
+	{
+		ifstream in(path);
+		for ( istream_iterator<string> it {in}, eos; it != eos; ++it )
+		{
+			++words[0];
+			letters[0] += it->size();
+		}
+	});
+	Report("istream_iterator<string>", words[0], bytes, sec);
+	for ( int i = 1; i < 3; ++i )
+	{
+		sec = TimeSec([&]
+		{
+			WordSource source(path.c_str(), i == 1);
+			for ( string_view w = source.Next(); !w.empty(); w = source.Next() )
+			{
+				++words[i];
+				letters[i] += w.size();
+			}
+		});
+		Report(i == 1 ? "WordSource (mmap)" : "WordSource (read)", words[i], bytes, sec);
+	}
+	if ( words[1] != words[0] || words[2] != words[0] || letters[1] != letters[0] || letters[2] != letters[0] )
+		cout << "Different words!\n";
+	cout << '\n';
+}
+
+
+
+void SortUniqueBenchmark(const string& path)
+{
+	const size_t bytes = filesystem::file_size(path);
+	size_t words = 0;
+	for ( WordSource source(path.c_str()); !source.Next().empty(); )  ++words;
+	string expected;
+	auto run = [&](const char* name, auto process)
+	{
+		ostringstream out;
+		const double sec = TimeSec([&]{ process(out); });
+		Report(name, words, bytes, sec);
+		if ( expected.empty() )  expected = out.str();
+		else if ( out.str() != expected )  cout << "Different output!\n";
+	};
+	run("Func1 (sort, unique_copy)", [&](ostream& out) { ifstream in(path); Func1(in, out); });
+	run("Func2 (set<string>)", [&](ostream& out) { ifstream in(path); Func2(in, out); });
+	const unsigned cores = thread::hardware_concurrency();
+	for ( unsigned threads = 1; ; threads = min(2 * threads, cores) )
+	{
+		const string name = "SortedUniqueWords (" + to_string(threads) + " threads)";
+		run(name.c_str(), [&](ostream& out)
+		{
+			WordSource source(path.c_str());
+			string storage;
+			WriteWords(SortedUniqueWords(WholeText(path, source, storage), threads), out);
+		});
+		if ( threads >= cores )  break;
+	}
+	cout << "Distinct words: " << count(expected.begin(), expected.end(), ',') << "\n\n";
+}
+
+
+
+void ExternalSortBenchmark(const string& path)
+{
+	const size_t bytes = filesystem::file_size(path);
+	ostringstream expected;
+	WordSource mapped(path.c_str());
+	string storage;
+	WriteWords(SortedUniqueWords(WholeText(path, mapped, storage)), expected);
+	size_t words = 0;
+	for ( WordSource source(path.c_str()); !source.Next().empty(); )  ++words;
+
+	for ( size_t budget_mb : {256, 64, 8} )
+	{
+		ostringstream out;
+		size_t runs = 0;
+		const double sec = TimeSec([&]
+		{
+			ExternalSortUnique sorter(budget_mb << 20);
+			WordSource source(path.c_str(), false);  // read(), so that memory stays bounded
+			for ( string_view w = source.Next(); !w.empty(); w = source.Next() )  sorter.Add(w);
+			sorter.Finish(ostream_iterator<string_view> {out, ", "});
+			runs = sorter.Runs();
+		});
+		const string name = "ExternalSortUnique (" + to_string(budget_mb) + " MB)";
+		Report(name.c_str(), words, bytes, sec);
+		cout << "    " << runs << " runs";
+		cout << (out.str() == expected.str() ? "\n" : ", different output!\n");
+	}
+	try
+	{
+		ExternalSortUnique(8 << 20).Add("two\nwords");
+	}
+	catch ( const invalid_argument& e )
+	{
+		cout << e.what() << '\n';
+	}
+	cout << '\n';
+}
+
+
+
+size_t HeapInUse()  // glibc: small blocks plus the mmap()ed large ones
+{
+	const struct mallinfo2 mi = mallinfo2();
+	return mi.uordblks + mi.hblkhd;
+}
+
+
+
+// Repeated words from the file, then mostly distinct random words
+void InterningBenchmark(const string& path)
+{
+	WordSource mapped(path.c_str());
+	const vector<string_view> corpus(mapped.begin(), mapped.end());
+	mt19937 gen(3);
+	uniform_int_distribution<int> length(4, 14), letter('a', 'z');
+	string distinct_text;
+	for ( int i = 0; i < 5'000'000; ++i )
+	{
+		for ( int n = length(gen); n > 0; --n )  distinct_text += static_cast<char>(letter(gen));
+		distinct_text += ' ';
+	}
+	WordSource distinct_source(distinct_text);
+	const vector<string_view> distinct(distinct_source.begin(), distinct_source.end());
+
+	for ( const auto* words : {&corpus, &distinct} )
+	{
+		string expected, got;
+		auto run = [&](const char* name, auto insert, auto export_sorted)
+		{
+			const size_t heap = HeapInUse();
+			const double sec = TimeSec([&]{ for ( string_view w : *words )  insert(w); });
+			const double mb = (HeapInUse() - heap) / 1e6;
+			ostringstream out;
+			export_sorted(out);
+			(expected.empty() ? expected : got) = out.str();
+			cout << setw(26) << left << name << right << setw(7) << words->size() / sec / 1e6
+			     << " Mwords/s " << setw(8) << mb << " MB";
+			cout << (got.empty() || got == expected ? "\n" : "  different!\n");
+		};
+		cout << words->size() << " words:\n";
+		{
+			set<string> s;
+			run("set<string>", [&](string_view w) { s.emplace(w); },
+			    [&](ostream& out) { WriteWords(s, out); });
+		}
+		{
+			unordered_set<string> s;
+			run("unordered_set<string>", [&](string_view w) { s.emplace(w); }, [&](ostream& out)
+			{
+				vector<string_view> v(s.begin(), s.end());
+				sort(v.begin(), v.end());
+				WriteWords(v, out);
+			});
+		}
+		{
+			StringInterner interner;
+			run("StringInterner", [&](string_view w) { interner.Intern(w); }, [&](ostream& out)
+			{
+				interner.CopySorted(ostream_iterator<string_view> {out, ", "});
+			});
+			cout << "    " << interner.size() << " distinct, "
+			     << interner.MemoryBytes() / 1e6 << " MB by MemoryBytes()\n";
+		}
+	}
+	cout << '\n';
+}
+
+
+
+// Tokens are written to /dev/null, so only the cost of the output path is
+// measured. Standard output is redirected there for the cout variants.
+void OutputBenchmark(const string& path)
+{
+	WordSource source(path.c_str());
+	vector<string_view> words;
+	for ( string_view w : source )
+	{
+		words.push_back(w);
+		if ( words.size() == 20'000'000 )  break;
+	}
+	cout.flush();
+	fflush(stdout);
+	const int saved_stdout = dup(STDOUT_FILENO);
+	const int null = open("/dev/null", O_WRONLY);
+	dup2(null, STDOUT_FILENO);
+	double sec[3];
+	sec[0] = TimeSec([&]
+	{
+		copy(words.begin(), words.end(), ostream_iterator<string_view> {cout, ", "});
+		cout.flush();
+	});
+	ios::sync_with_stdio(false);
+	sec[1] = TimeSec([&]
+	{
+		copy(words.begin(), words.end(), ostream_iterator<string_view> {cout, ", "});
+		cout.flush();
+	});
+	sec[2] = TimeSec([&]
+	{
+		FdSink sink(STDOUT_FILENO);
+		copy(words.begin(), words.end(), SinkIterator {sink, ", "});
+		sink.Flush();
+	});
+	dup2(saved_stdout, STDOUT_FILENO);
+	close(saved_stdout);
+	close(null);
+
+	size_t bytes = 0;
+	for ( string_view w : words )  bytes += w.size() + 2;
+	Report("ostream_iterator, cout", words.size(), bytes, sec[0]);
+	Report("  sync_with_stdio(false)", words.size(), bytes, sec[1]);
+	Report("SinkIterator, FdSink", words.size(), bytes, sec[2]);
+	cout << '\n';
+}
+
+
+
+void FrequencyDemo(const string& path)
+{
+	WordSource source(path.c_str());
+	string storage;
+	const WordCounter counter = CountWords(WholeText(path, source, storage));
+	cout << "Most frequent words:\n";
+	CopyCounts(counter.Top(5), ostream_iterator<string_view> {cout, "\n"});
+	HeavyHitters hitters(5);
+	for ( WordSource again(path.c_str(), false); ; )
+	{
+		const string_view w = again.Next();
+		if ( w.empty() )  break;
+		hitters.Add(w);
+	}
+	cout << "By count-min sketch, " << hitters.MemoryBytes() / 1e6 << " MB:\n";
+	CopyCounts(hitters.Top(), ostream_iterator<string_view> {cout, "\n"});
+	cout << '\n';
+}
+
+
+
+// Tokens per second and memory for growing vocabularies on text generated
+// in memory. The heavy hitters are checked against the exact top 10.
+void FrequencyBenchmark()
+{
+	const size_t k = 10;
+	const unsigned cores = thread::hardware_concurrency();
+	for ( size_t vocabulary : {1'000, 100'000, 1'000'000} )
+	{
+		const string text = MakeText(128 << 20, vocabulary, 7);
+		size_t tokens = 0;
+		for ( WordSource source(text); !source.Next().empty(); )  ++tokens;
+		auto row = [&](const string& name, double sec, size_t bytes)
+		{
+			cout << setw(30) << left << name << right << setw(7) << tokens / sec / 1e6
+			     << " Mwords/s " << setw(8) << bytes / 1e6 << " MB\n";
+		};
+		cout << "Vocabulary " << vocabulary << ", " << tokens << " tokens:\n";
+		{
+			unordered_map<string, uint64_t> counts;
+			const size_t heap = HeapInUse();
+			const double sec = TimeSec([&]
+			{
+				WordSource source(text);
+				for ( string_view w = source.Next(); !w.empty(); w = source.Next() )  ++counts[string(w)];
+			});
+			row("unordered_map<string, ...>", sec, HeapInUse() - heap);
+		}
+		WordCounter exact;
+		for ( unsigned threads = 1; ; threads = min(2 * threads, cores) )
+		{
+			const double sec = TimeSec([&]{ exact = CountWords(text, threads); });
+			row("CountWords (" + to_string(threads) + " threads)", sec, exact.MemoryBytes());
+			if ( threads >= cores )  break;
+		}
+		cout << "    " << exact.size() << " distinct words\n";
+
+		HeavyHitters hitters(4 * k);
+		const double sec = TimeSec([&]
+		{
+			WordSource source(text);
+			for ( string_view w = source.Next(); !w.empty(); w = source.Next() )  hitters.Add(w);
+		});
+		row("HeavyHitters", sec, hitters.MemoryBytes());
+		const auto top = exact.Top(k);
+		auto approx = hitters.Top();
+		approx.resize(min(k, approx.size()));
+		size_t found = 0;
+		for ( const auto& t : top )
+			found += any_of(approx.begin(), approx.end(), [&](const WordCount& a) { return a.word == t.word; });
+		cout << "    " << found << " of the top " << k << " found\n";
+	}
+	cout << '\n';
+}
+
+
+
+int main(int argc, char* argv[])
+{
+	const bool temporary = argc < 2 || !filesystem::is_regular_file(argv[1]);
+	const string path = argc < 2 ? MakeCorpus(256 << 20, 100'000, 1)
+	                             : (temporary ? CopyInput(argv[1]) : argv[1]);
+	cout << fixed << setprecision(1);
+	SinkDemo();
+	TokenizerDemo(path);
+	TokenizerBenchmark(path);
+	SortUniqueBenchmark(path);
+	ExternalSortBenchmark(path);
+	InterningBenchmark(path);
+	OutputBenchmark(path);
+	FrequencyDemo(path);
+	FrequencyBenchmark();
+	if ( temporary )  filesystem::remove(path);
+}